@@ -0,0 +1,153 @@
+/**
+ * A bump allocator which hands out memory from large chunks and frees it
+ * all at once. Keys and tree nodes are packed into chunks back to back
+ * instead of each costing its own malloc, and the whole arena is released
+ * with one free per chunk.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "mylib.h"
+
+
+/**
+ * The size of the first chunk, and the size past which chunks stop
+ * doubling. Larger chunks keep the number of chunks small for big
+ * dictionaries.
+ */
+#define ARENA_MIN_CHUNK (1 << 16)
+#define ARENA_MAX_CHUNK (1 << 24)
+
+
+/**
+ * Rounds a size up to a multiple of the alignment used for anything other
+ * than strings.
+ *
+ * @param x The size.
+ */
+#define ARENA_ALIGN(x) (((x) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+
+/**
+ * arena_chunk struct is the header of a block of memory handed out by an
+ * arena. The memory itself follows the header.
+ */
+struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;
+};
+
+
+/**
+ * arenarec struct is the blueprint for creating an instance of an arena.
+ */
+struct arenarec {
+    struct arena_chunk *chunks;
+    char *next;
+    size_t left;
+    size_t chunk_size;
+};
+
+
+/**
+ * Creates a new empty arena. No memory is taken for chunks until
+ * something is allocated.
+ *
+ * @return a The new arena.
+ */
+arena arena_new(void) {
+    arena a = emalloc(sizeof * a);
+    a->chunks = NULL;
+    a->next = NULL;
+    a->left = 0;
+    a->chunk_size = ARENA_MIN_CHUNK;
+    return a;
+}
+
+
+/**
+ * Takes memory from the current chunk, starting a new chunk if there is
+ * not enough left.
+ *
+ * @param a The arena.
+ * @param size The number of bytes needed.
+ *
+ * @return A pointer to the memory.
+ */
+static char *arena_take(arena a, size_t size) {
+    struct arena_chunk *c;
+    char *result;
+
+    if (size > a->left) {
+        while (a->chunk_size < size && a->chunk_size < ARENA_MAX_CHUNK) {
+            a->chunk_size *= 2;
+        }
+        c = emalloc(sizeof * c + (size > a->chunk_size ? size
+                                                        : a->chunk_size));
+        c->size = size > a->chunk_size ? size : a->chunk_size;
+        c->next = a->chunks;
+        a->chunks = c;
+        a->next = (char *)(c + 1);
+        a->left = c->size;
+        if (a->chunk_size < ARENA_MAX_CHUNK) {
+            a->chunk_size *= 2;
+        }
+    }
+    result = a->next;
+    a->next += size;
+    a->left -= size;
+    return result;
+}
+
+
+/**
+ * Allocates memory from an arena, aligned for any pointer or integer. The
+ * memory lives until the arena is freed.
+ *
+ * @param a The arena.
+ * @param size The number of bytes needed.
+ *
+ * @return A pointer to the memory.
+ */
+void *arena_alloc(arena a, size_t size) {
+    size_t pad = ARENA_ALIGN((size_t)a->next) - (size_t)a->next;
+    if (pad <= a->left) {
+        a->next += pad;
+        a->left -= pad;
+    }
+    return arena_take(a, ARENA_ALIGN(size));
+}
+
+
+/**
+ * Copies a string into an arena, packed straight after the last one.
+ *
+ * @param a The arena.
+ * @param str The string, which need not be '\0' terminated.
+ * @param len The length of the string.
+ *
+ * @return The '\0' terminated copy.
+ */
+char *arena_strndup(arena a, const char *str, size_t len) {
+    char *copy = arena_take(a, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+
+/**
+ * Frees an arena and everything that was allocated from it.
+ *
+ * @param a The arena.
+ */
+void arena_free(arena a) {
+    struct arena_chunk *c;
+    while (a->chunks != NULL) {
+        c = a->chunks;
+        a->chunks = c->next;
+        free(c);
+    }
+    free(a);
+}
@@ -0,0 +1,17 @@
+/**
+ * Header file for arena allocator implementation.
+ *
+ */
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stddef.h>
+
+typedef struct arenarec *arena;
+
+extern arena  arena_new(void);
+extern void  *arena_alloc(arena a, size_t size);
+extern char  *arena_strndup(arena a, const char *str, size_t len);
+extern void   arena_free(arena a);
+
+#endif
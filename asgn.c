@@ -1,10 +1,15 @@
 /**
  * Reads in a text file and stores it in either a Hash Table, a Binary Search
- * Tree, or a Red Black Tree. If nothing else is entered it simply returns the
- * words and their frequencies. If a second file is specified then in searches
- * for each word in the second file in the data structure. If words are not
+ * Tree, a Red Black Tree, a B-tree or a Radix Trie. If nothing else is
+ * entered it simply returns the words and their frequencies. If a second file
+ * is specified then in searches for each word in the second file in the data
+ * structure. If words are not
  * found then they are printed out, in this way it acts like a rudimentary
- * spell checker.
+ * spell checker. The dictionary can also be built once and served to many
+ * spell checks over a Unix domain socket.
+ *
+ * Compile with:
+ *    gcc -O2 -W -Wall -ansi -pedantic *.c -o asgn -pthread
  *
  * 13/09/18.
  * @author Kelson Sadlier
@@ -17,37 +22,64 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "tree.h"
+#include "trie.h"
+#include "btree.h"
 #include "mylib.h"
 #include "htable.h"
+#include "writer.h"
+
+
+/**
+ * The writer words and their frequencies are printed through.
+ */
+static writer out;
 
 
 /**
- * Prints the words and their frequencies to stdout.
+ * Prints the words and their frequencies to stdout, as "%-4d %s\n" would,
+ * through the writer.
  *
  * @param freq The number of copies of the word.
  * @param word The string itself.
  */
 static void print_info(int freq, char *word) {
-    printf("%-4d %s\n", freq, word);
+    writer_int(out, freq, 4);
+    writer_char(out, ' ');
+    writer_string(out, word);
+    writer_char(out, '\n');
 }
 
 
 int main(int argc, char **argv) {
 
-    FILE *document;
+    FILE *document = NULL;
     FILE *tree_view;
     char *document_name = NULL;
+    char *image_name = NULL;
+    char *save_name = NULL;
+    char *timing_name = NULL;
+    char *serve_socket = NULL;
+    char *server_socket = NULL;
     int table_size = 113;
-    const char *optstring = "Tc:deoprs:t:h";
+    const char *optstring = "ABC:S:Tb:c:defgH:i:J:j:l:m:opRrs:t:uw:xz:h";
     char option;
     int snaphots = 0;
+    char *end;
+    double max_load = -1.0;
+    double start;
     htable h;
     tree t;
+    trie r;
+    btree b;
     
     /* Command Line Flags */
     unsigned int data_stucture = 0;
-    unsigned int collision_strategy = 0; 
+    hashing_t collision_strategy = LINEAR_P;
+    hashfn_t hash_function = POLY31;
+    sizing_t sizing = PRIME_SIZE;
+    unsigned int hash_report = 0;
     unsigned int display_entire_contents = 0;
+    unsigned int freeze = 0;
     unsigned int output_tree_representation = 0;
     unsigned int print_stats_info = 0;
     unsigned int spell_check = 0;
@@ -59,25 +91,76 @@ int main(int argc, char **argv) {
     if (argc > 0) {
         while ((option = getopt(argc, argv, optstring)) != EOF) {
             switch (option) {
+                case 'A' :
+                    data_stucture = 2;
+                    break;
+                case 'B' :
+                    data_stucture = 3;
+                    break;
+                case 'C' :
+                    server_socket = optarg;
+                    break;
+                case 'S' :
+                    serve_socket = optarg;
+                    break;
                 case 'T' :
                     data_stucture = 1;
                     break;
+                case 'b' :
+                    if (!set_filter_rate(strtod(optarg, &end))
+                        || end == optarg || *end != '\0') {
+                        help = 2;
+                    }
+                    break;
                 case 'c' :
                     document_name = optarg;
                     spell_check = 1;
                     break;
                 case 'd' :
-                    collision_strategy = 1;
+                    collision_strategy = DOUBLE_H;
                     break;
                 case 'e' :
                     display_entire_contents = 1;
                     break;
+                case 'f' :
+                    freeze = 1;
+                    break;
+                case 'g' :
+                    collision_strategy = SWISS;
+                    break;
+                case 'H' :
+                    if (!htable_hash_by_name(optarg, &hash_function)) {
+                        help = 1;
+                    }
+                    break;
+                case 'i' :
+                    image_name = optarg;
+                    break;
+                case 'J' :
+                    timing_name = optarg;
+                    set_timing();
+                    break;
+                case 'j' :
+                    set_num_threads(atoi(optarg));
+                    break;
+                case 'l' :
+                    max_load = atof(optarg);
+                    break;
+                case 'm' :
+                    if (!set_filter_size(strtol(optarg, &end, 10))
+                        || *end != '\0') {
+                        help = 2;
+                    }
+                    break;
                 case 'o' :
                     output_tree_representation = 1;
                     break;
                 case 'p' :
                     print_stats_info = 1;
                     break;
+                case 'R' :
+                    collision_strategy = ROBIN_HOOD;
+                    break;
                 case 'r' :
                     tree_type = 1;
                     break;
@@ -85,6 +168,20 @@ int main(int argc, char **argv) {
                     use_snapshots = 1;
                     snaphots = atoi(optarg);
                     break;
+                case 'u' :
+                    set_unique_unknown();
+                    break;
+                case 'w' :
+                    save_name = optarg;
+                    break;
+                case 'x' :
+                    hash_report = 1;
+                    break;
+                case 'z' :
+                    if (!htable_sizing_by_name(optarg, &sizing)) {
+                        help = 1;
+                    }
+                    break;
                 case 'h' :
                     help = 1;
                     break;
@@ -97,6 +194,23 @@ int main(int argc, char **argv) {
             }
         }                                                     
 
+        /* The trie can't be saved, loaded, frozen or drawn */
+        if (data_stucture == 2 && (image_name != NULL || save_name != NULL
+                                   || freeze || output_tree_representation)) {
+            help = 2;
+        }
+
+        /* The B-tree can't be saved, loaded or frozen */
+        if (data_stucture == 3 && (image_name != NULL || save_name != NULL
+                                   || freeze)) {
+            help = 2;
+        }
+
+        /* A client needs a document to check, and a server can't be one */
+        if (server_socket != NULL && (!spell_check || serve_socket != NULL)) {
+            help = 1;
+        }
+
         /* If help is rrequested or a invalid command line argument is used */
         print_help(help);
 
@@ -105,30 +219,126 @@ int main(int argc, char **argv) {
             document = open_file(document_name);
         }
 
-        /* If data structure is tree */
-        if (data_stucture) {
-            if (tree_type) {
-                t = tree_new(RBT);
-            } else {;
-                t = tree_new(BST);
+        /* If the dictionary is held by a server, check spelling with it */
+        if (server_socket != NULL) {
+            search_server(server_socket, document);
+            print_basic_stats();
+            fclose(document);
+            if (timing_name != NULL) {
+                write_timing(timing_name);
             }
+            return EXIT_SUCCESS;
+        }
+
+        /* If data structure is B-tree */
+        if (data_stucture == 3) {
+            b = btree_new();
 
             /* Insert words from stdin */
-            t = insert_words_into_tree(t, stdin);
+            b = insert_words_into_btree(b, stdin);
 
-            /* If tree is rbt fix root */
-            if (tree_type) {
-                t = tree_fix_root(t);
+            /* If serving the dictionary, answer lookups until stopped */
+            if (serve_socket != NULL) {
+                serve_btree(b, serve_socket);
             }
 
             /* If no document file was provided, just print out dictionary */
             if (spell_check == 0) {
+                start = get_time();
+                out = writer_new(stdout);
+                btree_preorder(b, print_info);
+                writer_free(out);
+                if (output_tree_representation) {
+                    tree_view = fopen("tree_view.dot", "w");
+                    btree_output_dot(b, tree_view);
+                    fclose(tree_view);
+                }
+                add_phase_time(OUTPUT_PHASE, start);
+            } else {
+                /* Document to spell check is provided, check spelling */
+                search_btree(b, document);
+                print_basic_stats();
+            }
+
+            /* Free B-tree memory */
+            start = get_time();
+            btree_free(b);
+            add_phase_time(FREE_PHASE, start);
+
+        /* If data structure is trie */
+        } else if (data_stucture == 2) {
+            r = trie_new();
+
+            /* Insert words from stdin */
+            r = insert_words_into_trie(r, stdin);
+
+            /* If serving the dictionary, answer lookups until stopped */
+            if (serve_socket != NULL) {
+                serve_trie(r, serve_socket);
+            }
+
+            /* If no document file was provided, just print out dictionary */
+            if (spell_check == 0) {
+                start = get_time();
+                out = writer_new(stdout);
+                trie_preorder(r, print_info);
+                writer_free(out);
+                add_phase_time(OUTPUT_PHASE, start);
+            } else {
+                /* Document to spell check is provided, check spelling */
+                search_trie(r, document);
+                print_basic_stats();
+            }
+
+            /* Free trie memory */
+            start = get_time();
+            trie_free(r);
+            add_phase_time(FREE_PHASE, start);
+
+        /* If data structure is tree */
+        } else if (data_stucture) {
+            if (image_name != NULL) {
+                /* Load words from a saved image */
+                t = load_tree(image_name);
+            } else {
+                if (tree_type) {
+                    t = tree_new(RBT);
+                } else {;
+                    t = tree_new(BST);
+                }
+
+                /* Insert words from stdin */
+                t = insert_words_into_tree(t, stdin);
+
+                /* If tree is rbt fix root */
+                if (tree_type) {
+                    t = tree_fix_root(t);
+                }
+            }
+            if (save_name != NULL) {
+                tree_save(t, save_name);
+            }
+            if (freeze) {
+                tree_freeze(t);
+            }
+
+            /* If serving the dictionary, answer lookups until stopped */
+            if (serve_socket != NULL) {
+                serve_tree(t, serve_socket);
+            }
+
+            /* If no document file was provided, just print out dictionary */
+            if (spell_check == 0) {
+                start = get_time();
+                out = writer_new(stdout);
                 tree_preorder(t, print_info);
+                writer_free(out);
                 if (output_tree_representation) {
                     tree_view = fopen("tree_view.dot", "w");
                     tree_output_dot(t, tree_view);
                     fclose(tree_view);
                 }
+                add_phase_time(OUTPUT_PHASE, start);
             } else {
                 /* Document to spell check is provided, check spelling */
                 search_tree(t, document);
@@ -136,44 +346,84 @@ int main(int argc, char **argv) {
             }
             
             /* Free tree memory */
+            start = get_time();
             tree_free(t);
+            add_phase_time(FREE_PHASE, start);
             
         } else {
             /* If data structure is hash table */
-            table_size = get_next_prime(table_size);
-            
-            if (collision_strategy) {
-                h = htable_new(table_size, DOUBLE_H);
+            if (image_name != NULL) {
+                /* Load words from a saved image */
+                h = load_htable(image_name);
             } else {
-                h = htable_new(table_size, LINEAR_P);
-            }
+                h = htable_new(table_size, collision_strategy, hash_function,
+                               sizing);
+                if (max_load >= 0.0) {
+                    htable_set_max_load(h, max_load);
+                }
 
-            /* Insert words from stdin */
-            insert_words_into_htable(h, stdin);
+                /* Insert words from stdin */
+                insert_words_into_htable(h, stdin);
+            }
+            if (freeze && !htable_freeze(h)) {
+                fprintf(stderr, "Can't freeze the hash table, "
+                        "searching it unfrozen\n");
+            }
+            if (save_name != NULL) {
+                htable_save(h, save_name);
+            }
             if (display_entire_contents) {
                 htable_print_entire_table(h, stderr);
             }
 
+            /* If serving the dictionary, answer lookups until stopped */
+            if (serve_socket != NULL) {
+                serve_htable(h, serve_socket);
+            }
+
             /* If no document is provided, print out dictionary */
             if (spell_check == 0) {
+                start = get_time();
+                out = writer_new(stdout);
                 htable_print(h, print_info);
-                
+                writer_free(out);
+                add_phase_time(OUTPUT_PHASE, start);
+
                 /* If user wants snapshot stats */
                 if (print_stats_info && use_snapshots) {
                     htable_print_stats(h, stdout, snaphots);
                 }
+                if (print_stats_info && hash_report) {
+                    htable_print_hash_report(h, stdout);
+                }
             } else {
                 /* Document to spell check is provided, check spelling */ 
+                if (print_stats_info && use_snapshots) {
+                    /* Probe counts are kept in the table, so only one
+                       thread may search it */
+                    htable_record_searches(h);
+                    set_num_threads(1);
+                }
                 search_htable(h, document);
                 print_basic_stats();
+                if (print_stats_info && use_snapshots) {
+                    htable_print_stats(h, stderr, snaphots);
+                }
             }
             /* Free hash table memory */
+            start = get_time();
             htable_free(h);
+            add_phase_time(FREE_PHASE, start);
         }
         /* Close the docuemnt file */
         if (spell_check) {
             fclose(document);
         }
+
+        /* Write out how long each phase took */
+        if (timing_name != NULL) {
+            write_timing(timing_name);
+        }
     }
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,554 @@
+/**
+ * Benchmarks every dictionary structure against synthetic corpora, so that
+ * configurations can be compared and regressions caught without timing
+ * asgn by hand.
+ *
+ * For each dictionary size from 10^3 up to the largest asked for, a
+ * vocabulary of random words is made, and inserted both sorted and
+ * shuffled. Documents are drawn from it with Zipfian word frequencies, and
+ * a given fraction of their words are misspelt by changing one letter.
+ * Every structure is built and searched in a process of its own, so its
+ * peak memory can be read back on its own, and one row is printed for each
+ * run as CSV, or as JSON with -J.
+ *
+ * Compile from the top of the source tree with:
+ *    make bench
+ *
+ */
+#define _POSIX_C_SOURCE 200112L
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "arena.h"
+#include "btree.h"
+#include "htable.h"
+#include "mylib.h"
+#include "tree.h"
+#include "trie.h"
+
+
+/**
+ * The number of lookups timed together for the latency percentiles, since
+ * timing one lookup at a time would mostly measure the clock, and the
+ * largest bst built from sorted words, which takes quadratic time.
+ */
+#define BENCH_BATCH 32
+#define BENCH_MAX_SORTED_BST 20000
+
+
+/**
+ * The structures benchmarked, and the names they are reported by.
+ */
+typedef enum {
+    LINEAR, DOUBLE, ROBIN, GROUP, FROZEN, BST_TREE, RBT_TREE, FLAT_TREE,
+    B_TREE, RADIX_TRIE, NUM_STRUCTURES
+} structure_t;
+
+static const char *structure_names[] = {
+    "linear", "double", "robin", "swiss", "frozen", "bst", "rbt", "rbt-flat",
+    "btree", "trie"
+};
+
+
+/**
+ * words struct holds a list of words as (pointer, length) views.
+ */
+struct words {
+    const char **word;
+    int *len;
+    int n;
+};
+
+
+/**
+ * The state of the random number generator, the hash function and sizing
+ * the hash tables use, whether rows are printed as JSON, and how many rows have
+ * been printed.
+ */
+static unsigned int bench_seed = 2463534242U;
+static hashfn_t bench_hash = POLY31;
+static sizing_t bench_sizing = PRIME_SIZE;
+static int bench_json = 0;
+static int bench_rows = 0;
+
+
+/**
+ * Gets the next number from a xorshift generator.
+ *
+ * @return A random number.
+ */
+static unsigned int bench_rand(void) {
+    bench_seed ^= (bench_seed << 13) & 0xffffffffU;
+    bench_seed ^= bench_seed >> 17;
+    bench_seed ^= (bench_seed << 5) & 0xffffffffU;
+    return bench_seed;
+}
+
+
+/**
+ * Gets a random number between 0 and 1.
+ *
+ * @return The number, which is less than 1.
+ */
+static double bench_uniform(void) {
+    return bench_rand() / 4294967296.0;
+}
+
+
+/**
+ * Gets the peak memory used by this process so far.
+ *
+ * @return The peak resident set size, in kilobytes.
+ */
+static long bench_peak_kb(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+
+/**
+ * Allocates a list with room for a number of words.
+ *
+ * @param n The number of words.
+ *
+ * @return The list, which is empty.
+ */
+static struct words *words_new(int n) {
+    struct words *w = emalloc(sizeof * w);
+    w->word = emalloc(n * sizeof w->word[0]);
+    w->len = emalloc(n * sizeof w->len[0]);
+    w->n = 0;
+    return w;
+}
+
+
+/**
+ * Frees a list of words, but not the words.
+ *
+ * @param w The list.
+ */
+static void words_free(struct words *w) {
+    free(w->word);
+    free(w->len);
+    free(w);
+}
+
+
+/**
+ * Makes a vocabulary of distinct random words, 2 to 12 letters long.
+ *
+ * @param n The number of words.
+ * @param store The arena to keep the words in.
+ *
+ * @return The words, in the order they were made.
+ */
+static struct words *make_vocabulary(int n, arena store) {
+    struct words *w = words_new(n);
+    htable seen = htable_new(2 * n, LINEAR_P, WYMIX, POW2_SIZE);
+    char buf[16];
+    int i, len;
+
+    while (w->n < n) {
+        len = 2 + bench_rand() % 11;
+        for (i = 0; i < len; i++) {
+            buf[i] = 'a' + bench_rand() % 26;
+        }
+        if (htable_insert_n(seen, buf, len) == 1) {
+            w->word[w->n] = arena_strndup(store, buf, len);
+            w->len[w->n] = len;
+            w->n++;
+        }
+    }
+    htable_free(seen);
+    return w;
+}
+
+
+/**
+ * Compares two words by where they point, for qsort.
+ *
+ * @param a The first word.
+ * @param b The second word.
+ *
+ * @return The order of the words, as strcmp gives it.
+ */
+static int compare_words(const void *a, const void *b) {
+    return strcmp(*(const char * const *)a, *(const char * const *)b);
+}
+
+
+/**
+ * Makes a sorted copy of a vocabulary.
+ *
+ * @param vocab The vocabulary.
+ *
+ * @return The words in sorted order.
+ */
+static struct words *sort_vocabulary(struct words *vocab) {
+    struct words *w = words_new(vocab->n);
+    int i;
+
+    memcpy(w->word, vocab->word, vocab->n * sizeof w->word[0]);
+    qsort(w->word, vocab->n, sizeof w->word[0], compare_words);
+    for (i = 0; i < vocab->n; i++) {
+        w->len[i] = strlen(w->word[i]);
+    }
+    w->n = vocab->n;
+    return w;
+}
+
+
+/**
+ * Makes a document of words drawn from a vocabulary, where the word of
+ * rank k turns up in proportion to 1 / k, and some of the words are
+ * misspelt by changing one of their letters.
+ *
+ * @param vocab The vocabulary, most common word first.
+ * @param n The number of words in the document.
+ * @param rate The fraction of words to misspell.
+ * @param store The arena to keep misspelt words in.
+ *
+ * @return The document.
+ */
+static struct words *make_document(struct words *vocab, int n, double rate,
+                                   arena store) {
+    struct words *w = words_new(n);
+    double *cdf = emalloc(vocab->n * sizeof cdf[0]);
+    double total = 0.0, u;
+    char buf[16];
+    int i, lo, hi, mid, pos;
+
+    for (i = 0; i < vocab->n; i++) {
+        total += 1.0 / (i + 1);
+        cdf[i] = total;
+    }
+    for (w->n = 0; w->n < n; w->n++) {
+        u = bench_uniform() * total;
+        lo = 0;
+        hi = vocab->n - 1;
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (cdf[mid] < u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        w->word[w->n] = vocab->word[lo];
+        w->len[w->n] = vocab->len[lo];
+        if (bench_uniform() < rate) {
+            memcpy(buf, vocab->word[lo], vocab->len[lo]);
+            pos = bench_rand() % vocab->len[lo];
+            buf[pos] = 'a' + (buf[pos] - 'a' + 1 + bench_rand() % 25) % 26;
+            w->word[w->n] = arena_strndup(store, buf, vocab->len[lo]);
+        }
+    }
+    free(cdf);
+    return w;
+}
+
+
+/**
+ * Compares two latencies, for qsort.
+ *
+ * @param a The first latency.
+ * @param b The second latency.
+ *
+ * @return Less than, equal to or greater than 0 as a is less than, equal
+ * to or greater than b.
+ */
+static int compare_latency(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+
+/**
+ * Gets a percentile of a sorted list of latencies.
+ *
+ * @param lat The latencies.
+ * @param n The number of latencies.
+ * @param p The percentile, from 0 to 100.
+ *
+ * @return The latency.
+ */
+static double percentile(const double *lat, int n, double p) {
+    int i = (int)(p / 100.0 * (n - 1) + 0.5);
+    return n > 0 ? lat[i] : 0.0;
+}
+
+
+/**
+ * Prints one result, as a row of CSV or a JSON object.
+ *
+ * @param s The structure.
+ * @param order The order the dictionary was inserted in.
+ * @param size The number of words in the dictionary.
+ * @param rate The fraction of the document which was misspelt.
+ * @param lookups The number of words in the document.
+ * @param build_time The time taken to build the structure.
+ * @param search_time The time taken to check the document.
+ * @param lat The sorted latencies of each batch of lookups, in ns per
+ * lookup.
+ * @param batches The number of batches.
+ * @param unknown The number of words which were not found.
+ * @param base_kb The peak memory used before building the structure.
+ * @param peak_kb The peak memory used by the end.
+ */
+static void print_row(structure_t s, const char *order, int size,
+                      double rate, int lookups, double build_time,
+                      double search_time, const double *lat, int batches,
+                      int unknown, long base_kb, long peak_kb) {
+    if (bench_json) {
+        printf("%s  {\"structure\": \"%s\", \"order\": \"%s\", "
+               "\"dict_size\": %d, \"miss_rate\": %g, \"lookups\": %d, ",
+               bench_rows > 0 ? ",\n" : "", structure_names[s], order, size,
+               rate, lookups);
+        printf("\"build_s\": %f, \"inserts_per_s\": %.0f, "
+               "\"search_s\": %f, \"lookups_per_s\": %.0f, ",
+               build_time, size / build_time, search_time,
+               lookups / search_time);
+        printf("\"ns_p50\": %.1f, \"ns_p90\": %.1f, \"ns_p99\": %.1f, "
+               "\"ns_p999\": %.1f, \"ns_max\": %.1f, ",
+               percentile(lat, batches, 50), percentile(lat, batches, 90),
+               percentile(lat, batches, 99), percentile(lat, batches, 99.9),
+               percentile(lat, batches, 100));
+        printf("\"unknown\": %d, \"base_kb\": %ld, \"peak_kb\": %ld}",
+               unknown, base_kb, peak_kb);
+    } else {
+        printf("%s,%s,%d,%g,%d,%f,%.0f,%f,%.0f,", structure_names[s], order,
+               size, rate, lookups, build_time, size / build_time,
+               search_time, lookups / search_time);
+        printf("%.1f,%.1f,%.1f,%.1f,%.1f,%d,%ld,%ld\n",
+               percentile(lat, batches, 50), percentile(lat, batches, 90),
+               percentile(lat, batches, 99), percentile(lat, batches, 99.9),
+               percentile(lat, batches, 100), unknown, base_kb, peak_kb);
+    }
+}
+
+
+/**
+ * Builds one structure from a dictionary, searches it for every word of a
+ * document and prints how it went. This runs in a process of its own.
+ *
+ * @param s The structure.
+ * @param dict The dictionary, in the order to insert it.
+ * @param order The name of that order.
+ * @param doc The document.
+ * @param rate The fraction of the document which was misspelt.
+ */
+static void run(structure_t s, struct words *dict, const char *order,
+                struct words *doc, double rate) {
+    int batches = (doc->n + BENCH_BATCH - 1) / BENCH_BATCH;
+    double *lat = emalloc(batches * sizeof lat[0]);
+    double start, build_time, search_time, batch_start;
+    long base_kb = bench_peak_kb();
+    htable h = NULL;
+    tree t = NULL;
+    btree b = NULL;
+    trie r = NULL;
+    int i, j, end, found = 0, unknown = 0;
+
+    start = get_time();
+    if (s <= FROZEN) {
+        h = htable_new(113, s == DOUBLE ? DOUBLE_H : s == ROBIN ? ROBIN_HOOD
+                       : s == GROUP ? SWISS : LINEAR_P, bench_hash,
+                       bench_sizing);
+        for (i = 0; i < dict->n; i++) {
+            htable_insert_n(h, dict->word[i], dict->len[i]);
+        }
+        if (s == FROZEN) {
+            htable_freeze(h);
+        }
+    } else if (s <= FLAT_TREE) {
+        t = tree_new(s == BST_TREE ? BST : RBT);
+        for (i = 0; i < dict->n; i++) {
+            t = tree_insert_n(t, dict->word[i], dict->len[i]);
+        }
+        if (s == FLAT_TREE) {
+            tree_freeze(t);
+        }
+    } else if (s == B_TREE) {
+        b = btree_new();
+        for (i = 0; i < dict->n; i++) {
+            b = btree_insert_n(b, dict->word[i], dict->len[i]);
+        }
+    } else {
+        r = trie_new();
+        for (i = 0; i < dict->n; i++) {
+            r = trie_insert_n(r, dict->word[i], dict->len[i]);
+        }
+    }
+    build_time = get_time() - start;
+
+    start = get_time();
+    for (i = 0; i < batches; i++) {
+        end = (i + 1) * BENCH_BATCH < doc->n ? (i + 1) * BENCH_BATCH : doc->n;
+        batch_start = get_time();
+        for (j = i * BENCH_BATCH; j < end; j++) {
+            if (h != NULL) {
+                found = htable_search_n(h, doc->word[j], doc->len[j]);
+            } else if (t != NULL) {
+                found = tree_search_n(t, doc->word[j], doc->len[j]);
+            } else if (b != NULL) {
+                found = btree_search_n(b, doc->word[j], doc->len[j]);
+            } else {
+                found = trie_search_n(r, doc->word[j], doc->len[j]);
+            }
+            unknown += found == 0;
+        }
+        lat[i] = (get_time() - batch_start) * 1e9 / (end - i * BENCH_BATCH);
+    }
+    search_time = get_time() - start;
+
+    qsort(lat, batches, sizeof lat[0], compare_latency);
+    print_row(s, order, dict->n, rate, doc->n, build_time, search_time, lat,
+              batches, unknown, base_kb, bench_peak_kb());
+    free(lat);
+}
+
+
+/**
+ * Runs every structure against one dictionary and document, each in a
+ * process of its own.
+ *
+ * @param dict The dictionary, in the order to insert it.
+ * @param order The name of that order.
+ * @param doc The document.
+ * @param rate The fraction of the document which was misspelt.
+ */
+static void run_all(struct words *dict, const char *order, struct words *doc,
+                    double rate) {
+    pid_t pid;
+    int s, status;
+
+    for (s = 0; s < NUM_STRUCTURES; s++) {
+        if (s == BST_TREE && strcmp(order, "sorted") == 0
+            && dict->n > BENCH_MAX_SORTED_BST) {
+            fprintf(stderr, "Skipping bst on %d sorted words\n", dict->n);
+            continue;
+        }
+        fflush(stdout);
+        pid = fork();
+        if (pid == 0) {
+            run((structure_t)s, dict, order, doc, rate);
+            fflush(stdout);
+            _exit(EXIT_SUCCESS);
+        } else if (pid < 0) {
+            fprintf(stderr, "Can't start a run\n");
+            exit(EXIT_FAILURE);
+        }
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+            fprintf(stderr, "The %s run failed\n", structure_names[s]);
+        } else {
+            bench_rows++;
+        }
+    }
+}
+
+
+/**
+ * Prints out how to use the benchmark.
+ */
+static void print_usage(void) {
+    fprintf(stderr, "Usage: ./bench/bench [OPTIONS]...\n\n\
+Benchmark every dictionary structure on synthetic dictionaries of\n\
+10^3 words up to MAX words, sorted and shuffled, checking documents\n\
+with Zipfian word frequencies. Results go to stdout as CSV.\n\n");
+    fprintf(stderr, "\
+ -d LOOKUPS   Check documents of LOOKUPS words (default 1000000)\n\
+ -H HASH      Hash with HASH: poly31 (default), fnv1a or wymix\n\
+ -J \t      Print the results as JSON instead of CSV\n\
+ -m RATE      Misspell RATE of the document (default runs 0, 0.05\n\
+              and 0.25)\n\
+ -n MAX       Go up to dictionaries of MAX words (default 1000000)\n\
+ -s SEED      Seed the random words with SEED\n\
+ -z SIZING    Size hash tables by SIZING: prime (default), pow2 or\n\
+              range\n\n\
+ -h \t      Display this message\n\n");
+}
+
+
+int main(int argc, char **argv) {
+    double rates[3] = { 0.0, 0.05, 0.25 };
+    int num_rates = 3, max_size = 1000000, lookups = 1000000;
+    int size, i, option;
+    struct words *vocab, *sorted, *doc;
+    arena store;
+
+    while ((option = getopt(argc, argv, "d:H:Jm:n:s:z:h")) != EOF) {
+        switch (option) {
+            case 'd' :
+                lookups = atoi(optarg);
+                break;
+            case 'H' :
+                if (!htable_hash_by_name(optarg, &bench_hash)) {
+                    print_usage();
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'J' :
+                bench_json = 1;
+                break;
+            case 'm' :
+                rates[0] = atof(optarg);
+                num_rates = 1;
+                break;
+            case 'n' :
+                max_size = atoi(optarg);
+                break;
+            case 's' :
+                bench_seed = (unsigned int)strtoul(optarg, NULL, 10) | 1;
+                break;
+            case 'z' :
+                if (!htable_sizing_by_name(optarg, &bench_sizing)) {
+                    print_usage();
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                print_usage();
+                return option == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (lookups < 1 || max_size < 1000) {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    if (bench_json) {
+        printf("[\n");
+    } else {
+        printf("structure,order,dict_size,miss_rate,lookups,build_s,"
+               "inserts_per_s,search_s,lookups_per_s,ns_p50,ns_p90,ns_p99,"
+               "ns_p999,ns_max,unknown,base_kb,peak_kb\n");
+    }
+    for (size = 1000; size <= max_size; size *= 10) {
+        store = arena_new();
+        vocab = make_vocabulary(size, store);
+        sorted = sort_vocabulary(vocab);
+        for (i = 0; i < num_rates; i++) {
+            doc = make_document(vocab, lookups, rates[i], store);
+            run_all(sorted, "sorted", doc, rates[i]);
+            run_all(vocab, "shuffled", doc, rates[i]);
+            words_free(doc);
+        }
+        words_free(sorted);
+        words_free(vocab);
+        arena_free(store);
+        if (size > max_size / 10) {
+            break;
+        }
+    }
+    if (bench_json) {
+        printf("\n]\n");
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,233 @@
+/**
+ * A blocked Bloom filter, which can say for certain that a word is not in a
+ * set of words, and otherwise says it may be. Each word is given one block
+ * the size of a cache line, and all of its bits are set in that block, so
+ * checking a word costs a single cache miss however many bits it uses.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "bloom.h"
+#include "mylib.h"
+
+
+/**
+ * The number of bits in a block, which is one 64 byte cache line, and the
+ * number of 32 bit words that makes.
+ */
+#define BLOOM_BLOCK_BITS 512
+#define BLOOM_BLOCK_WORDS (BLOOM_BLOCK_BITS / 32)
+
+
+/**
+ * The most bits set for each word, and 1 / ln 2.
+ */
+#define BLOOM_MAX_HASHES 16
+#define BLOOM_LOG2_E 1.4426950408889634
+
+
+/**
+ * bloomrec struct is the blueprint for creating an instance of a Bloom
+ * filter. blocks is mem rounded up to the start of a cache line.
+ */
+struct bloomrec {
+    unsigned int *blocks;
+    void *mem;
+    unsigned int num_blocks;
+    int hashes;
+};
+
+
+/**
+ * Works out the base 2 logarithm of a number, one bit of the fraction at a
+ * time by repeated squaring, so that the math library is not needed.
+ *
+ * @param x The number, which must be greater than 0.
+ *
+ * @return The logarithm.
+ */
+static double bloom_log2(double x) {
+    double result = 0.0, bit = 1.0;
+    int i;
+
+    while (x < 1.0) {
+        x *= 2.0;
+        result -= 1.0;
+    }
+    while (x >= 2.0) {
+        x /= 2.0;
+        result += 1.0;
+    }
+    for (i = 0; i < 24; i++) {
+        x *= x;
+        bit /= 2.0;
+        if (x >= 2.0) {
+            x /= 2.0;
+            result += bit;
+        }
+    }
+    return result;
+}
+
+
+/**
+ * Creates an empty Bloom filter for a number of words, sized for a false
+ * positive rate or given a size. A plain Bloom filter needs -log2(rate) /
+ * ln 2 bits per word with that many times ln 2 bits set for each, so when
+ * only one of the rate and size is given the other follows from it, and
+ * when both are the rate only picks the number of bits set. Keeping each
+ * word to one block makes blocks fill unevenly, so the real rate is a
+ * little higher.
+ *
+ * @param num_keys The number of words that will be added.
+ * @param rate The fraction of words not in the filter it should let
+ * through, or 0 to work it out from the size.
+ * @param size The size of the filter in bytes, or 0 to size it for the
+ * rate.
+ *
+ * @return b The Bloom filter.
+ */
+bloom bloom_new(int num_keys, double rate, size_t size) {
+    bloom b = emalloc(sizeof * b);
+    double keys = num_keys > 0 ? num_keys : 1;
+    double bits_per_key = size > 0 ? 8.0 * size / keys
+        : -bloom_log2(rate) * BLOOM_LOG2_E;
+    double bits = size > 0 ? 8.0 * size : bits_per_key * keys;
+
+    b->hashes = (int)((rate > 0.0 ? -bloom_log2(rate)
+                       : bits_per_key / BLOOM_LOG2_E) + 0.5);
+    if (b->hashes < 1) {
+        b->hashes = 1;
+    } else if (b->hashes > BLOOM_MAX_HASHES) {
+        b->hashes = BLOOM_MAX_HASHES;
+    }
+    b->num_blocks = (unsigned int)(bits / BLOOM_BLOCK_BITS);
+    if (size == 0 || b->num_blocks == 0) {
+        b->num_blocks++;
+    }
+    b->mem = emalloc(b->num_blocks * (BLOOM_BLOCK_BITS / 8) + 63);
+    b->blocks = (unsigned int *)(((size_t)b->mem + 63) & ~(size_t)63);
+    memset(b->blocks, 0, b->num_blocks * (BLOOM_BLOCK_BITS / 8));
+    return b;
+}
+
+
+/**
+ * Hashes a word with 32 bit FNV-1a, then scrambles the result with the
+ * murmur3 finaliser so every bit of it depends on every byte.
+ *
+ * @param key The word.
+ * @param len The length of the word.
+ *
+ * @return The hash.
+ */
+static unsigned int bloom_hash(const char *key, int len) {
+    unsigned int h = 2166136261U;
+    while (len-- > 0) {
+        h ^= (unsigned char)*key++;
+        h *= 16777619U;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bU;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35U;
+    h ^= h >> 16;
+    return h & 0xffffffffU;
+}
+
+
+/**
+ * Finds the block for a word. The bits within it are then picked by the
+ * top 9 bits of successive steps of a generator seeded by the hash.
+ *
+ * @param b The Bloom filter.
+ * @param h The hash of the word.
+ *
+ * @return The block.
+ */
+static unsigned int *bloom_block(bloom b, unsigned int h) {
+    return b->blocks + (h % b->num_blocks) * BLOOM_BLOCK_WORDS;
+}
+
+
+/**
+ * Adds a word to the Bloom filter.
+ *
+ * @param b The Bloom filter.
+ * @param key The word, which need not be '\0' terminated.
+ * @param len The length of the word.
+ */
+void bloom_add(bloom b, const char *key, int len) {
+    unsigned int h = bloom_hash(key, len);
+    unsigned int *block = bloom_block(b, h);
+    unsigned int bit;
+    int i;
+
+    for (i = 0; i < b->hashes; i++) {
+        h = (h * 0x2c1b3c6dU + 0x297a2d39U) & 0xffffffffU;
+        bit = h >> 23;
+        block[bit >> 5] |= 1U << (bit & 31);
+    }
+}
+
+
+/**
+ * Checks whether a word may have been added to the Bloom filter.
+ *
+ * @param b The Bloom filter.
+ * @param key The word, which need not be '\0' terminated.
+ * @param len The length of the word.
+ *
+ * @return 0 if the word was certainly not added, and 1 if it may have
+ * been.
+ */
+int bloom_check(bloom b, const char *key, int len) {
+    unsigned int h = bloom_hash(key, len);
+    const unsigned int *block = bloom_block(b, h);
+    unsigned int bit;
+    int i;
+
+    for (i = 0; i < b->hashes; i++) {
+        h = (h * 0x2c1b3c6dU + 0x297a2d39U) & 0xffffffffU;
+        bit = h >> 23;
+        if ((block[bit >> 5] & (1U << (bit & 31))) == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * Gets the size of the Bloom filter.
+ *
+ * @param b The Bloom filter.
+ *
+ * @return The number of bytes of bits it holds.
+ */
+size_t bloom_size(bloom b) {
+    return (size_t)b->num_blocks * (BLOOM_BLOCK_BITS / 8);
+}
+
+
+/**
+ * Gets the number of bits set for each word.
+ *
+ * @param b The Bloom filter.
+ *
+ * @return The number of bits.
+ */
+int bloom_hashes(bloom b) {
+    return b->hashes;
+}
+
+
+/**
+ * Frees the memory allocated to the Bloom filter.
+ *
+ * @param b The Bloom filter.
+ */
+void bloom_free(bloom b) {
+    free(b->mem);
+    free(b);
+}
@@ -0,0 +1,19 @@
+/**
+ * Header file for blocked Bloom filter implementation.
+ *
+ */
+#ifndef BLOOM_H_
+#define BLOOM_H_
+
+#include <stddef.h>
+
+typedef struct bloomrec *bloom;
+
+extern bloom  bloom_new(int num_keys, double rate, size_t size);
+extern void   bloom_add(bloom b, const char *key, int len);
+extern int    bloom_check(bloom b, const char *key, int len);
+extern size_t bloom_size(bloom b);
+extern int    bloom_hashes(bloom b);
+extern void   bloom_free(bloom b);
+
+#endif
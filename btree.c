@@ -0,0 +1,410 @@
+/**
+ * A B-tree, holding words and their frequencies with the same interface as
+ * the binary tree. Each node holds up to BTREE_MAX words in order, so a
+ * lookup visits a handful of wide nodes instead of one node per comparison,
+ * and walking the words in order reads them a node at a time.
+ *
+ * Alongside each word a node keeps its first four bytes as a number which
+ * sorts the same way as the word, in an array of their own, so a node is
+ * searched by scanning that array and only words sharing those four bytes
+ * are ever compared in full.
+ *
+ */
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include "btree.h"
+#include "arena.h"
+#include "mylib.h"
+
+
+/**
+ * The minimum degree of the tree, and the most words a node can hold. Every
+ * node but the root holds at least BTREE_MIN - 1 words.
+ */
+#define BTREE_MIN 8
+#define BTREE_MAX (2 * BTREE_MIN - 1)
+
+
+typedef struct btree_node *subbtree;
+
+
+/**
+ * btree_node struct is the blueprint for creating a node of a B-tree.
+ * The words of a node are kept in order across prefix, key and freq, and
+ * child[i] holds the words between key[i - 1] and key[i]. Leaves have no
+ * children, and are allocated without room for them.
+ */
+struct btree_node {
+    unsigned int prefix[BTREE_MAX];
+    int num_keys;
+    int leaf;
+    char *key[BTREE_MAX];
+    int freq[BTREE_MAX];
+    subbtree child[BTREE_MAX + 1];
+};
+
+
+/**
+ * btreerec struct is the handle for a B-tree. It holds the root node and
+ * the arena which the nodes and keys of the tree are allocated from, so
+ * they are packed together and can all be freed at once.
+ */
+struct btreerec {
+    subbtree root;
+    arena store;
+};
+
+
+/**
+ * Creates a new empty B-tree.
+ *
+ * @return A new B-tree.
+ */
+btree btree_new(void) {
+    btree B = emalloc(sizeof * B);
+    B->root = NULL;
+    B->store = arena_new();
+    return B;
+}
+
+
+/**
+ * Allocates an empty node.
+ *
+ * @param B The tree the node belongs to.
+ * @param leaf 1 if the node is a leaf, and 0 if it will have children.
+ *
+ * @return The node.
+ */
+static subbtree btree_alloc(btree B, int leaf) {
+    subbtree x = arena_alloc(B->store, leaf
+                             ? offsetof(struct btree_node, child)
+                             : sizeof * x);
+
+    x->num_keys = 0;
+    x->leaf = leaf;
+    return x;
+}
+
+
+/**
+ * Works out the first four bytes of a word as a number, padded with 0s,
+ * which compares with those of other words the same way strcmp would.
+ *
+ * @param key The word, which need not be '\0' terminated.
+ * @param len The length of the word.
+ *
+ * @return The prefix.
+ */
+static unsigned int btree_prefix(const char *key, int len) {
+    unsigned int p = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        p = (p << 8) | (i < len ? (unsigned char)key[i] : 0);
+    }
+    return p;
+}
+
+
+/**
+ * Finds where a word belongs in a node. Only words with the same prefix
+ * are compared in full, and then only past the prefix, since a word
+ * shorter than the prefix which shares it must be the same word.
+ *
+ * @param x The node.
+ * @param key The word, which need not be '\0' terminated.
+ * @param len The length of the word.
+ * @param p The prefix of the word.
+ * @param found Set to 1 if the word is in the node, and 0 if not.
+ *
+ * @return The index of the first word in the node which does not come
+ * before the word.
+ */
+static int btree_find(subbtree x, const char *key, int len, unsigned int p,
+                      int *found) {
+    int i = 0, cmp;
+
+    *found = 0;
+    while (i < x->num_keys && x->prefix[i] < p) {
+        i++;
+    }
+    while (i < x->num_keys && x->prefix[i] == p) {
+        if (len < 4) {
+            *found = 1;
+            break;
+        }
+        cmp = strncmp(x->key[i] + 4, key + 4, len - 4);
+        if (cmp == 0) {
+            cmp = x->key[i][len] != '\0';
+        }
+        if (cmp >= 0) {
+            *found = cmp == 0;
+            break;
+        }
+        i++;
+    }
+    return i;
+}
+
+
+/**
+ * Moves words from one place in a node to another, which may overlap.
+ *
+ * @param dst The node to move the words to.
+ * @param di The index to move them to.
+ * @param src The node to move the words from.
+ * @param si The index to move them from.
+ * @param n The number of words.
+ */
+static void btree_move(subbtree dst, int di, subbtree src, int si, int n) {
+    memmove(dst->prefix + di, src->prefix + si, n * sizeof dst->prefix[0]);
+    memmove(dst->key + di, src->key + si, n * sizeof dst->key[0]);
+    memmove(dst->freq + di, src->freq + si, n * sizeof dst->freq[0]);
+}
+
+
+/**
+ * Splits the full child i of a node in two, moving its middle word up into
+ * the node between the halves.
+ *
+ * @param B The tree the node belongs to.
+ * @param x The node, which must not be full.
+ * @param i The index of the child.
+ */
+static void btree_split(btree B, subbtree x, int i) {
+    subbtree y = x->child[i];
+    subbtree z = btree_alloc(B, y->leaf);
+
+    z->num_keys = BTREE_MIN - 1;
+    btree_move(z, 0, y, BTREE_MIN, BTREE_MIN - 1);
+    if (!y->leaf) {
+        memcpy(z->child, y->child + BTREE_MIN, BTREE_MIN * sizeof z->child[0]);
+    }
+    y->num_keys = BTREE_MIN - 1;
+
+    memmove(x->child + i + 2, x->child + i + 1,
+            (x->num_keys - i) * sizeof x->child[0]);
+    x->child[i + 1] = z;
+    btree_move(x, i + 1, x, i, x->num_keys - i);
+    btree_move(x, i, y, BTREE_MIN - 1, 1);
+    x->num_keys++;
+}
+
+
+/**
+ * Inserts a string into the tree, counting it a number of times. The tree
+ * is walked down from the root without recursion, and any full node on the
+ * way is split before it is entered, so there is always room for a word
+ * moved up out of the node below.
+ *
+ * @param B The tree we are inserting a word into.
+ * @param key The string we wish to place in the tree, which need not be
+ * '\0' terminated.
+ * @param len The length of the string.
+ * @param count The number of times to count the string.
+ *
+ * @return B the newly updated tree.
+ */
+btree btree_insert_count(btree B, const char *key, int len, int count) {
+    unsigned int p = btree_prefix(key, len);
+    subbtree x, root;
+    int i, found;
+
+    if (B->root == NULL) {
+        B->root = btree_alloc(B, 1);
+    } else if (B->root->num_keys == BTREE_MAX) {
+        root = btree_alloc(B, 0);
+        root->child[0] = B->root;
+        btree_split(B, root, 0);
+        B->root = root;
+    }
+    x = B->root;
+    for (;;) {
+        i = btree_find(x, key, len, p, &found);
+        if (found) {
+            x->freq[i] += count;
+            return B;
+        }
+        if (x->leaf) {
+            break;
+        }
+        if (x->child[i]->num_keys == BTREE_MAX) {
+            btree_split(B, x, i);
+            i = btree_find(x, key, len, p, &found);
+            if (found) {
+                x->freq[i] += count;
+                return B;
+            }
+        }
+        x = x->child[i];
+    }
+    btree_move(x, i + 1, x, i, x->num_keys - i);
+    x->prefix[i] = p;
+    x->key[i] = arena_strndup(B->store, key, len);
+    x->freq[i] = count;
+    x->num_keys++;
+    return B;
+}
+
+
+/**
+ * Inserts a string into the tree.
+ *
+ * @param B The tree we are inserting a word into.
+ * @param key The string we wish to place in the tree, which need not be
+ * '\0' terminated.
+ * @param len The length of the string.
+ *
+ * @return B the newly updated tree.
+ */
+btree btree_insert_n(btree B, const char *key, int len) {
+    return btree_insert_count(B, key, len, 1);
+}
+
+
+/**
+ * Inserts a '\0' terminated string into the tree.
+ *
+ * @param B The tree we are inserting a word into.
+ * @param key The string we wish to place in the tree.
+ *
+ * @return B the newly updated tree.
+ */
+btree btree_insert(btree B, char *key) {
+    return btree_insert_n(B, key, strlen(key));
+}
+
+
+/**
+ * Searches the tree for a string. Searching does not change the tree, so
+ * any number of threads can search it at once.
+ *
+ * @param B The tree to search.
+ * @param key The string to search for, which need not be '\0' terminated.
+ * @param len The length of the string.
+ *
+ * @return The frequency of the string, or 0 if it was not found.
+ */
+int btree_search_n(btree B, const char *key, int len) {
+    unsigned int p = btree_prefix(key, len);
+    subbtree x = B->root;
+    int i, found;
+
+    while (x != NULL) {
+        i = btree_find(x, key, len, p, &found);
+        if (found) {
+            return x->freq[i];
+        }
+        x = x->leaf ? NULL : x->child[i];
+    }
+    return 0;
+}
+
+
+/**
+ * Searches the tree for a '\0' terminated string.
+ *
+ * @param B The tree to search.
+ * @param key The string to search for.
+ *
+ * @return The frequency of the string, or 0 if it was not found.
+ */
+int btree_search(btree B, char *key) {
+    return btree_search_n(B, key, strlen(key));
+}
+
+
+/**
+ * Executes a function on each word below a node in the order the words
+ * sort in, which for a B-tree is the order its nodes hold them in.
+ *
+ * @param x The node, which must not be NULL.
+ * @param f(char *key) The function to be executed.
+ */
+static void btree_walk(subbtree x, void f(int freq, char *key)) {
+    int i;
+
+    for (i = 0; i < x->num_keys; i++) {
+        if (!x->leaf) {
+            btree_walk(x->child[i], f);
+        }
+        f(x->freq[i], x->key[i]);
+    }
+    if (!x->leaf) {
+        btree_walk(x->child[i], f);
+    }
+}
+
+
+/**
+ * Executes a function on each word of the tree in the order the words sort
+ * in.
+ *
+ * @param B The tree on which to execute the function.
+ * @param f(char *key) The function to be executed.
+ */
+void btree_preorder(btree B, void f(int freq, char *key)) {
+    if (B->root != NULL) {
+        btree_walk(B->root, f);
+    }
+}
+
+
+/**
+ * Traverses the tree writing a DOT description of each node, as a record
+ * of its words between the links to its children, and of those links.
+ *
+ * @param B the tree to output a DOT description of.
+ * @param out the stream to write the DOT output to.
+ */
+static void btree_output_dot_aux(subbtree B, FILE *out) {
+    int i;
+
+    fprintf(out, "\"%s\"[label=\"<f0>", B->key[0]);
+    for (i = 0; i < B->num_keys; i++) {
+        fprintf(out, "|%s:%d|<f%d>", B->key[i], B->freq[i], i + 1);
+    }
+    fprintf(out, "\"];\n");
+    if (!B->leaf) {
+        for (i = 0; i <= B->num_keys; i++) {
+            btree_output_dot_aux(B->child[i], out);
+            fprintf(out, "\"%s\":f%d -> \"%s\":f0;\n", B->key[0], i,
+                    B->child[i]->key[0]);
+        }
+    }
+}
+
+
+/**
+ * Output a DOT description of this tree to the given output stream, in the
+ * same way as tree_output_dot.
+ *
+ * @param B the tree to output the DOT description of.
+ * @param out the stream to write the DOT description to.
+ */
+void btree_output_dot(btree B, FILE *out) {
+    fprintf(out, "digraph tree {\nnode [shape = record, penwidth = 2];\n");
+    if (B->root != NULL) {
+        btree_output_dot_aux(B->root, out);
+    }
+    fprintf(out, "}\n");
+}
+
+
+/**
+ * Frees all memory assosiated with the tree, one free per arena chunk,
+ * leaving any other tree as it was.
+ *
+ * @param B the tree we wish to deallocate memory for.
+ *
+ * @return a pointer to our now empty tree.
+ */
+btree btree_free(btree B) {
+    arena_free(B->store);
+    free(B);
+    B = NULL;
+    return B;
+}
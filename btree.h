@@ -0,0 +1,24 @@
+/**
+ * Header file for B-tree implementation.
+ *
+ */
+#ifndef BTREE_H_
+#define BTREE_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+
+typedef struct btreerec *btree;
+
+extern btree    btree_new(void);
+extern btree    btree_insert(btree B, char *key);
+extern btree    btree_insert_n(btree B, const char *key, int len);
+extern btree    btree_insert_count(btree B, const char *key, int len,
+                                   int count);
+extern int      btree_search(btree B, char *key);
+extern int      btree_search_n(btree B, const char *key, int len);
+extern void     btree_preorder(btree B, void f(int frequency, char *key));
+extern void     btree_output_dot(btree B, FILE *out);
+extern btree    btree_free(btree B);
+
+#endif
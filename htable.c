@@ -10,109 +10,1217 @@
 #include <stdio.h>
 #include <string.h>
 #include "htable.h"
+#include "arena.h"
+#include "image.h"
 #include "mylib.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 
 /**
- * Macro for checking the collision resolution strategy.
+ * Macros for checking the collision resolution strategy.
  *
  * @param x The given hash table.
  */
 #define IS_DHASH(x) (DOUBLE_H == (x)->method)
+#define IS_RHASH(x) (ROBIN_HOOD == (x)->method)
+#define IS_SWISS(x) (SWISS == (x)->method)
+#define IS_FROZEN(x) (NULL != (x)->disp)
+
+
+/**
+ * Group probing keeps a one byte control tag per slot, in groups of 16
+ * which are checked together. An empty slot is tagged with EMPTY, a full
+ * one with the low 7 bits of its keys hash, and the rest of the hash
+ * picks the group to start from.
+ *
+ * @param x The hash of a key.
+ */
+#define GROUP_SIZE 16
+#define EMPTY ((signed char)-128)
+#define H1(x) ((x) >> 7)
+#define H2(x) ((signed char)((x) & 0x7f))
+
+
+/**
+ * Load factor at which a new table starts to grow, and the number of old
+ * slots moved into the grown table each time a new key is inserted.
+ */
+#define HTABLE_DEFAULT_LOAD 0.75
+#define HTABLE_REHASH_STEP 4
+
+
+/**
+ * The longest probe length given a row of its own in the histogram of
+ * probe lengths. Longer probes are counted in its row.
+ */
+#define PROBE_LIMIT 255
+
+
+/**
+ * The number of words htable_search_batch works on at once, and a hint
+ * to start loading the cache line holding an address, where the processor
+ * takes such hints.
+ *
+ * @param p The address.
+ */
+#define HTABLE_BATCH 16
+#ifdef __SSE2__
+#define PREFETCH(p) _mm_prefetch((const char *)(p), _MM_HINT_T0)
+#else
+#define PREFETCH(p) ((void)(p))
+#endif
+
+
+/**
+ * Unsigned 64 bit integer used by the multiply-rotate hash, and the odd
+ * constants it multiplies by, built from 32 bit halves to stay within C90.
+ */
+__extension__ typedef unsigned long long hash_word;
+#define HASH_CONST(hi, lo) (((hash_word)(hi) << 32) | (hash_word)(lo))
+#define WY_K1 HASH_CONST(0xa0761d64, 0x78bd642f)
+#define WY_K2 HASH_CONST(0xe7037ed1, 0xa0b428db)
+#define WY_K3 HASH_CONST(0x8ebc6af0, 0x9c88c6e3)
+
+
+/**
+ * A frozen table hashes its keys into buckets of about FROZEN_BUCKET keys,
+ * and finds each bucket a displacement which puts all of its keys in free
+ * slots. A bucket is given up on after FROZEN_PASSES passes over the
+ * table, and the whole table after FROZEN_SEEDS hash seeds have failed.
+ */
+#define FROZEN_BUCKET 4
+#define FROZEN_PASSES 64
+#define FROZEN_SEEDS 8
+
+
+/**
+ * htable_slot struct holds one position of a hash table. The full hash of
+ * the key is kept beside it, so that slots holding other keys can almost
+ * always be passed over without comparing strings; in a frozen table it is
+ * part of the keys seeded hash instead. With Robin Hood hashing
+ * stats is the keys current distance from its home slot, which changes as
+ * keys are shuffled along, and with group probing it is the number of
+ * full groups passed over when the key was placed. Otherwise it is the
+ * number of collisions that occurred when the key was placed.
+ */
+struct htable_slot {
+    char *key;
+    unsigned int hash;
+    int freq;
+    int stats;
+};
+
+
+/**
+ * htablerec struct is the blueprint for creating an instance of a hash table.
+ * A table loaded from an image has its slots, control tags, insertion
+ * order and keys in the mapping held by map. probe_log holds the number
+ * of probes each key took to place, in the order the keys were inserted,
+ * and hits and misses count the probe lengths of lookups which found and
+ * did not find their word.
+ */
+struct htablerec {
+    int capacity;
+    int num_keys;
+    struct htable_slot *slots;
+    signed char *ctrl;
+    char **order;
+    int *probe_log;
+    long hits[PROBE_LIMIT + 1];
+    long misses[PROBE_LIMIT + 1];
+    int record_searches;
+    arena key_store;
+    char *map;
+    size_t map_len;
+    hashing_t method;
+    hashfn_t hash_fn;
+    sizing_t sizing;
+    double max_load;
+    htable old;
+    int rehash_pos;
+    long compares;
+    long compares_skipped;
+    unsigned int *disp;
+    int num_buckets;
+    hash_word seed;
+};
+
+
+/**
+ * htable_image struct heads an image of a hash table. The slots, insertion
+ * order, displacements, insertion log and control tags follow at the given
+ * offsets, with the keys after them in insertion order. The control tags
+ * come last as they are single bytes, which keeps the rest aligned. The
+ * displacement and control tag offsets are 0 for tables which have none.
+ */
+struct htable_image {
+    struct image_header header;
+    int capacity;
+    int num_keys;
+    hashing_t method;
+    hashfn_t hash_fn;
+    sizing_t sizing;
+    int num_buckets;
+    hash_word seed;
+    size_t slots;
+    size_t order;
+    size_t disp;
+    size_t ctrl;
+    size_t probes;
+};
+
+
+/**
+ * Converts a word into an integer to be a strings location in the hash table.
+ * This is the original h * 31 + c hash, kept as the default so that tables
+ * are laid out as they always have been.
+ *
+ * @param word The string to convert.
+ * @param len The length of the string.
+ * @return result The integer resulting from the string conversion.
+ */
+static unsigned int hash_poly31(const char *word, int len){
+    unsigned int result = 0;
+    while(len-- > 0){
+        result = (*word++ + 31 * result);
+    }
+    return result;
+}
+
+
+/**
+ * Converts a word into an integer using the 32 bit FNV-1a hash, which
+ * mixes in every byte with an xor and a multiply by the FNV prime.
+ *
+ * @param word The string to convert.
+ * @param len The length of the string.
+ * @return result The integer resulting from the string conversion.
+ */
+static unsigned int hash_fnv1a(const char *word, int len) {
+    unsigned int result = 2166136261U;
+    while (len-- > 0) {
+        result ^= (unsigned char)*word++;
+        result *= 16777619U;
+    }
+    return result & 0xffffffffU;
+}
+
+
+/**
+ * Converts a word into a 64 bit integer with a multiply-rotate hash in the
+ * style of wyhash. The word is taken 8 bytes at a time, each multiplied,
+ * mixed into the state and rotated, and the result is finished with a
+ * final avalanche so the high and low bits are equally good.
+ *
+ * @param word The string to convert.
+ * @param len The length of the string.
+ * @param seed The starting state, which gives a different hash for each
+ * value.
+ * @return The integer resulting from the string conversion.
+ */
+static hash_word hash_wymix64(const char *word, int len, hash_word seed) {
+    hash_word result = seed ^ (hash_word)len;
+    hash_word w;
+
+    for (; len > 0; word += 8, len -= 8) {
+        w = 0;
+        memcpy(&w, word, len < 8 ? len : 8);
+        result ^= w * WY_K2;
+        result = ((result << 29) | (result >> 35)) * WY_K3;
+    }
+    result ^= result >> 32;
+    result *= WY_K2;
+    return result ^ (result >> 29);
+}
+
+
+/**
+ * Converts a word into an integer with the multiply-rotate hash, folded
+ * down to 32 bits.
+ *
+ * @param word The string to convert.
+ * @param len The length of the string.
+ * @return The integer resulting from the string conversion.
+ */
+static unsigned int hash_wymix(const char *word, int len) {
+    hash_word result = hash_wymix64(word, len, WY_K1);
+    return (unsigned int)(result ^ (result >> 32));
+}
+
+
+/**
+ * The hash functions a table can use, in the same order as hashfn_t, and
+ * the names they are known by.
+ */
+static unsigned int (*const hash_fns[])(const char *word, int len) = {
+    hash_poly31, hash_fnv1a, hash_wymix
+};
+static const char *const hash_names[] = { "poly31", "fnv1a", "wymix" };
+
+
+/**
+ * The names the ways of sizing a table are known by, in the same order as
+ * sizing_t.
+ */
+static const char *const sizing_names[] = { "prime", "pow2", "range" };
+
+
+/**
+ * Converts a word into an integer using the hash function chosen for the
+ * table.
+ *
+ * @param h The hash table.
+ * @param word The string to convert.
+ * @param len The length of the string.
+ * @return The integer resulting from the string conversion.
+ */
+static unsigned int htable_word_to_int(htable h, const char *word, int len) {
+    return hash_fns[h->hash_fn](word, len);
+}
+
+
+/**
+ * Looks up a hash function by name.
+ *
+ * @param name The name of the hash function.
+ * @param f Set to the hash function if it is found.
+ *
+ * @return 1 if there is a hash function with that name and 0 if not.
+ */
+int htable_hash_by_name(const char *name, hashfn_t *f) {
+    int i;
+    for (i = 0; i < (int)(sizeof hash_names / sizeof hash_names[0]); i++) {
+        if (strcmp(name, hash_names[i]) == 0) {
+            *f = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Looks up a way of sizing a table by name.
+ *
+ * @param name The name of the sizing.
+ * @param z Set to the sizing if it is found.
+ *
+ * @return 1 if there is a sizing with that name and 0 if not.
+ */
+int htable_sizing_by_name(const char *name, sizing_t *z) {
+    int i;
+    for (i = 0; i < (int)(sizeof sizing_names / sizeof sizing_names[0]); i++) {
+        if (strcmp(name, sizing_names[i]) == 0) {
+            *z = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Compares a key stored in the table with a word which may not be '\0'
+ * terminated.
+ *
+ * @param key The stored key.
+ * @param str The word.
+ * @param len The length of the word.
+ *
+ * @return 1 if they are the same string and 0 if not.
+ */
+static int htable_key_equals(const char *key, const char *str, int len) {
+    return strncmp(key, str, len) == 0 && key[len] == '\0';
+}
+
+
+/**
+ * Maps a hash onto the range 0 to n - 1. Prime sized tables take the
+ * remainder, as they always have. Power of two sized tables keep the low
+ * bits, so want a hash whose low bits are well mixed. Fast range tables
+ * take the high half of the product of the hash and n, which spreads
+ * hashes evenly over any n without dividing. That uses the high bits of
+ * the hash, which poly31 leaves empty for short words, so the hash is
+ * first multiplied by 2^32 over the golden ratio to bring every bit up.
+ *
+ * @param h The hash table.
+ * @param x The hash.
+ * @param n The size of the range, which is a power of two for power of
+ * two sized tables.
+ *
+ * @return The hash reduced to the range.
+ */
+static unsigned int htable_reduce(htable h, unsigned int x, unsigned int n) {
+    if (h->sizing == POW2_SIZE) {
+        return x & (n - 1);
+    } else if (h->sizing == FAST_RANGE) {
+        return (unsigned int)(((hash_word)(x * 2654435769U) * n) >> 32);
+    }
+    return x % n;
+}
+
+
+/**
+ * Computes the step size to be used based on the collision
+ * resoloution method for the given hashtable. With double hashing every
+ * step must share no factor with the capacity so the probe sequence
+ * reaches every slot, which for a power of two capacity means an odd step
+ * taken from the high bits of the key, and otherwise a prime capacity.
+ *
+ * @param h The hash table.
+ * @param i_key The key in integer form of a string.
+ *
+ * @return Returns 1 if linear probing is used or if the table
+ * capacity is 1. Otherwise returns a step size based on the key value
+ * and tables capacity.
+ */
+static unsigned int htable_step(htable h, unsigned int i_key) {
+    if(!IS_DHASH(h) || h->capacity == 1){
+        return 1;
+    }else if (h->sizing == POW2_SIZE) {
+        return ((i_key >> 16) | 1) & (h->capacity - 1);
+    }else{
+        return 1 + htable_reduce(h, i_key, h->capacity - 1);
+    }
+}
+
+
+/**
+ * Moves an index on by a step along a probe sequence, wrapping around the
+ * end of the table. The step is always less than the capacity, so this
+ * never needs to divide.
+ *
+ * @param h The hash table.
+ * @param index The index.
+ * @param step The step.
+ *
+ * @return The next index.
+ */
+static unsigned int htable_next(htable h, unsigned int index,
+                                unsigned int step) {
+    index += step;
+    return index >= (unsigned int)h->capacity ? index - h->capacity : index;
+}
+
+
+/**
+ * Ends a probe, handing back how long it was.
+ *
+ * @param length Set to the length of the probe, unless it is NULL.
+ * @param index The slot the word was found in, or -1 if it is missing.
+ * @param probes The number of slots, or groups of slots, passed over.
+ *
+ * @return index.
+ */
+static int probe_end(int *length, int index, int probes) {
+    if (length != NULL) {
+        *length = probes;
+    }
+    return index;
+}
+
+
+/**
+ * Counts how long a lookup took among the lookups which found and did not
+ * find their word.
+ *
+ * @param tally The table to count the lookup in, or NULL to not count it.
+ * @param found Whether the word was found.
+ * @param probes The number of slots, or groups of slots, passed over.
+ */
+static void count_lookup(htable tally, int found, int probes) {
+    if (tally != NULL) {
+        if (probes > PROBE_LIMIT) {
+            probes = PROBE_LIMIT;
+        }
+        if (found) {
+            tally->hits[probes]++;
+        } else {
+            tally->misses[probes]++;
+        }
+    }
+}
+
+
+/**
+ * Finds which slots of a group have a particular control tag.
+ *
+ * @param ctrl The control tags of the group.
+ * @param tag The tag to look for.
+ *
+ * @return A mask with bit i set if slot i of the group has the tag.
+ */
+static unsigned int group_match(const signed char *ctrl, signed char tag) {
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+#else
+    unsigned int mask = 0;
+    int i;
+    for (i = 0; i < GROUP_SIZE; i++) {
+        if (ctrl[i] == tag) {
+            mask |= 1U << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+
+/**
+ * Finds the slot holding a word in a group probed table. Each group on the
+ * probe sequence is checked for the words tag with a single compare, and
+ * only slots with a matching tag have their stored hash and key looked at.
+ * The search ends at the first group with an empty slot. Groups are probed
+ * in triangular order, which visits every group of a power of two table.
+ *
+ * @param h The hash table.
+ * @param str The word to look for.
+ * @param len The length of the word.
+ * @param word_value The word in integer form.
+ * @param tally A table to count string compares made and skipped in, or
+ * NULL to not count them.
+ * @param length Set to the number of groups passed over, unless it is NULL.
+ *
+ * @return The index of the slot holding the word, or -1 if it is missing.
+ */
+static int htable_group_probe(htable h, const char *str, int len,
+                              unsigned int word_value, htable tally,
+                              int *length) {
+    unsigned int groups = h->capacity / GROUP_SIZE;
+    unsigned int group = H1(word_value) & (groups - 1);
+    unsigned int i, match, index;
+
+    for (i = 1; i <= groups; i++) {
+        match = group_match(h->ctrl + group * GROUP_SIZE, H2(word_value));
+        while (match != 0) {
+            index = group * GROUP_SIZE + __builtin_ctz(match);
+            if (h->slots[index].hash != word_value) {
+                if (tally != NULL) {
+                    tally->compares_skipped++;
+                }
+            } else {
+                if (tally != NULL) {
+                    tally->compares++;
+                }
+                if (htable_key_equals(h->slots[index].key, str, len)) {
+                    return probe_end(length, index, i - 1);
+                }
+            }
+            match &= match - 1;
+        }
+        if (group_match(h->ctrl + group * GROUP_SIZE, EMPTY) != 0) {
+            return probe_end(length, -1, i - 1);
+        }
+        group = (group + i) & (groups - 1);
+    }
+    return probe_end(length, -1, groups);
+}
+
+
+/**
+ * Places a key which is known not to be in a group probed table, in the
+ * first empty slot of the first group on its probe sequence which has one.
+ *
+ * @param h The hash table, which must have at least one empty slot.
+ * @param entry The key, its hash and its frequency.
+ *
+ * @return The index of the slot the key was placed in.
+ */
+static int htable_group_place(htable h, struct htable_slot entry) {
+    unsigned int groups = h->capacity / GROUP_SIZE;
+    unsigned int group = H1(entry.hash) & (groups - 1);
+    unsigned int i = 0, empty, index;
+
+    while ((empty = group_match(h->ctrl + group * GROUP_SIZE, EMPTY)) == 0) {
+        group = (group + ++i) & (groups - 1);
+    }
+    index = group * GROUP_SIZE + __builtin_ctz(empty);
+    entry.stats = i;
+    h->ctrl[index] = H2(entry.hash);
+    h->slots[index] = entry;
+    return index;
+}
+
+
+/**
+ * Works out which slot of a frozen table a key hashes to, given the
+ * displacement of its bucket.
+ *
+ * @param g The keys seeded 64 bit hash.
+ * @param d The displacement of the keys bucket.
+ * @param n The number of slots.
+ *
+ * @return The slot.
+ */
+static unsigned int frozen_slot(hash_word g, const unsigned int *d,
+                                unsigned int n) {
+    hash_word f1 = (g & 0xffffffffU) % n;
+    hash_word f2 = ((g * WY_K3) >> 32) % n;
+    return (unsigned int)((f1 + d[0] * f2 + d[1]) % n);
+}
+
+
+/**
+ * Finds the displacement of the bucket a key belongs to in a frozen table.
+ *
+ * @param h The hash table.
+ * @param g The keys seeded 64 bit hash.
+ *
+ * @return The displacement.
+ */
+static unsigned int *frozen_disp(htable h, hash_word g) {
+    return h->disp + 2 * ((unsigned int)(g >> 32) % h->num_buckets);
+}
+
+
+/**
+ * Finds the slot holding a word in a frozen table. Every key has a slot of
+ * its own given by the perfect hash, so the only slot to look at is the
+ * one the word hashes to, and a single compare tells whether it is there.
+ * The slot keeps some other bits of its keys seeded hash, which turn most
+ * missing words away without touching the key.
+ *
+ * @param h The hash table.
+ * @param str The word to look for.
+ * @param len The length of the word.
+ * @param g The words seeded 64 bit hash.
+ * @param tally A table to count string compares in, or NULL to not count
+ * them.
+ * @param length Set to the length of the probe, unless it is NULL.
+ *
+ * @return The index of the slot holding the word, or -1 if it is missing.
+ */
+static int htable_frozen_probe(htable h, const char *str, int len,
+                               hash_word g, htable tally, int *length) {
+    unsigned int index = frozen_slot(g, frozen_disp(h, g), h->capacity);
+
+    if (h->slots[index].hash != (unsigned int)(g >> 16)) {
+        if (tally != NULL) {
+            tally->compares_skipped++;
+        }
+        return probe_end(length, -1, 0);
+    }
+    if (tally != NULL) {
+        tally->compares++;
+    }
+    return probe_end(length, htable_key_equals(h->slots[index].key, str, len)
+                     ? (int)index : -1, 0);
+}
+
+
+/**
+ * Finds the slot holding a word by following its probe sequence. Slots
+ * whose stored hash differs from the words are passed over without looking
+ * at their key. With Robin Hood hashing the search stops as soon as it
+ * reaches a key closer to its home slot than the word would be, since the
+ * word would have displaced that key had it been inserted.
+ *
+ * @param h The hash table.
+ * @param str The word to look for.
+ * @param len The length of the word.
+ * @param word_value The word in integer form.
+ * @param tally A table to count string compares made and skipped in, or
+ * NULL to not count them.
+ * @param length Set to the length of the probe, unless it is NULL.
+ *
+ * @return The index of the slot holding the word, or -1 if it is missing.
+ */
+static int htable_probe(htable h, const char *str, int len,
+                        unsigned int word_value, htable tally, int *length) {
+    unsigned int index = htable_reduce(h, word_value, h->capacity);
+    unsigned int step = htable_step(h, word_value);
+    struct htable_slot *slot = &h->slots[index];
+    int collisions = 0;
+
+    if (IS_FROZEN(h)) {
+        return htable_frozen_probe(h, str, len,
+                                   hash_wymix64(str, len, h->seed), tally,
+                                   length);
+    } else if (IS_SWISS(h)) {
+        return htable_group_probe(h, str, len, word_value, tally, length);
+    }
+    while (slot->key != NULL) {
+        if (IS_RHASH(h) && slot->stats < collisions) {
+            return probe_end(length, -1, collisions);
+        } else if (slot->hash != word_value) {
+            if (tally != NULL) {
+                tally->compares_skipped++;
+            }
+        } else {
+            if (tally != NULL) {
+                tally->compares++;
+            }
+            if (htable_key_equals(slot->key, str, len)) {
+                return probe_end(length, index, collisions);
+            }
+        }
+        if (++collisions >= h->capacity) {
+            return probe_end(length, -1, collisions);
+        }
+        index = htable_next(h, index, step);
+        slot = &h->slots[index];
+    }
+    return probe_end(length, -1, collisions);
+}
+
+
+/**
+ * Places a key which is known not to be in the table yet. Linear probing
+ * and double hashing put it in the first empty slot on its probe sequence.
+ * Robin Hood hashing takes the slot of the first key it meets which is
+ * closer to home than it is, and carries that key on to the next such
+ * slot, until an empty slot is reached.
+ *
+ * @param h The hash table, which must have at least one empty slot.
+ * @param entry The key, its hash and its frequency.
+ *
+ * @return The index of the slot the key was placed in.
+ */
+static int htable_place(htable h, struct htable_slot entry) {
+    unsigned int index = htable_reduce(h, entry.hash, h->capacity);
+    unsigned int step = htable_step(h, entry.hash);
+    struct htable_slot displaced;
+    int placed = -1;
+
+    if (IS_SWISS(h)) {
+        return htable_group_place(h, entry);
+    }
+    entry.stats = 0;
+    while (h->slots[index].key != NULL) {
+        if (IS_RHASH(h) && h->slots[index].stats < entry.stats) {
+            displaced = h->slots[index];
+            h->slots[index] = entry;
+            entry = displaced;
+            if (placed < 0) {
+                placed = index;
+            }
+        }
+        index = htable_next(h, index, step);
+        entry.stats++;
+    }
+    h->slots[index] = entry;
+    return placed < 0 ? (int)index : placed;
+}
+
+
+/**
+ * Allocates the slots of a hash table and marks every slot empty. Group
+ * probed tables are rounded up to a power of two number of whole groups,
+ * and get a control tag for every slot. Other tables are rounded up to a
+ * power of two if power of two sized, and otherwise to a prime, except for
+ * fast range tables which do not double hash and so can be any size.
+ *
+ * @param h The hash table.
+ * @param capacity The number of slots wanted.
+ */
+static void htable_alloc_slots(htable h, int capacity) {
+    int i;
+    h->capacity = capacity;
+    h->ctrl = NULL;
+    if (IS_SWISS(h) || h->sizing == POW2_SIZE) {
+        for (h->capacity = IS_SWISS(h) ? GROUP_SIZE : 1;
+             h->capacity < capacity;) {
+            h->capacity *= 2;
+        }
+    } else if (h->sizing == PRIME_SIZE || IS_DHASH(h)) {
+        h->capacity = get_next_prime(capacity);
+    } else if (capacity < 1) {
+        h->capacity = 1;
+    }
+    if (IS_SWISS(h)) {
+        h->ctrl = emalloc(h->capacity * sizeof h->ctrl[0]);
+        memset(h->ctrl, EMPTY, h->capacity);
+    }
+    h->slots = emalloc(h->capacity * sizeof h->slots[0]);
+    for(i=0;i<h->capacity;i++){
+        h->slots[i].key = NULL;
+        h->slots[i].hash = 0;
+        h->slots[i].freq = 0;
+        h->slots[i].stats = 0;
+    }
+}
+
+
+/**
+ * Moves the next few slots of the table being drained into the current
+ * table, so that the cost of growing is spread over later inserts. Once
+ * every slot has been moved the old table is released. Keys are placed
+ * using their stored hashes, so nothing is rehashed or compared.
+ *
+ * @param h The hash table.
+ * @param slots The number of old slots to move, or -1 to move them all.
+ */
+static void htable_rehash_step(htable h, int slots) {
+    htable old = h->old;
+
+    while (old != NULL && slots-- != 0 && h->rehash_pos < old->capacity) {
+        if (old->slots[h->rehash_pos].key != NULL) {
+            htable_place(h, old->slots[h->rehash_pos]);
+        }
+        h->rehash_pos++;
+    }
+    if (old != NULL && h->rehash_pos == old->capacity) {
+        free(old->ctrl);
+        free(old->slots);
+        free(old);
+        h->old = NULL;
+    }
+}
+
+
+/**
+ * Starts growing the table once it is loaded past its maximum load factor.
+ * The current slots become the old table, which is drained into a table
+ * roughly twice the size by htable_rehash_step. A table loaded from an
+ * image keeps its size, since its slots are not its own to free.
+ *
+ * @param h The hash table.
+ */
+static void htable_maybe_grow(htable h) {
+    htable old;
+
+    if (h->old != NULL || h->map != NULL || h->max_load <= 0.0
+        || h->num_keys < h->max_load * h->capacity) {
+        return;
+    }
+    old = emalloc(sizeof * old);
+    *old = *h;
+    old->old = NULL;
+    h->old = old;
+    h->rehash_pos = 0;
+    htable_alloc_slots(h, 2 * old->capacity);
+    h->order = erealloc(h->order, h->capacity * sizeof h->order[0]);
+    h->probe_log = erealloc(h->probe_log,
+                            h->capacity * sizeof h->probe_log[0]);
+}
 
 
 /**
- * htablerec struct is the blueprint for creating an instance of a hash table.
+ * Sets the load factor past which the table grows. A load of 0 or less
+ * keeps the capacity fixed, in which case inserts fail once it is full.
+ *
+ * @param h The hash table.
+ * @param load The maximum fraction of slots to fill before growing.
  */
-struct htablerec {
-    int capacity;
-    int num_keys;
-    int *freq;
-    int *stats;
-    char **keys;
-    hashing_t method;
-};
+void htable_set_max_load(htable h, double load) {
+    h->max_load = load > 1.0 ? 1.0 : load;
+}
 
 
 /**
- * Converts a word into an integer to be a strings location in the hash table.
+ * Counts the probe lengths of searches as well as inserts. Searching a
+ * table which does this changes it, so it must then only be searched by
+ * one thread at a time.
  *
- * @param word The string to convert.
- * @return result The integer resulting from the string conversion.
+ * @param h The hash table.
  */
-static unsigned int htable_word_to_int(char *word){
-    unsigned int result = 0;
-    while(*word != '\0'){
-        result = (*word++ + 31 * result);
-    }
-    return result;
+void htable_record_searches(htable h) {
+    h->record_searches = 1;
 }
 
 
 /**
- * Computes the step size to be used based on the collision
- * resoloution method for the given hashtable.
+ * Empties the counts of compares and probe lengths of a table.
  *
  * @param h The hash table.
- * @param i_key The key in integer form of a string.
- *
- * @return Returns 1 if linear probing is used or if the table
- * capacity is 1. Otherwise returns a step size based on the key value
- * and tables capacity.
  */
-static unsigned int htable_step(htable h, unsigned int i_key) {
-    if(!IS_DHASH(h) || h->capacity == 1){
-        return 1;
-    }else{
-        return 1 + (i_key % (h->capacity - 1));
-    }
+static void htable_clear_counts(htable h) {
+    h->compares = 0;
+    h->compares_skipped = 0;
+    memset(h->hits, 0, sizeof h->hits);
+    memset(h->misses, 0, sizeof h->misses);
+    h->record_searches = 0;
 }
 
 
 /**
  * Creates a new empty hashtable, allocates memory and sets defualt values.
  *
- * @param capacity The tables maximum capacity.
+ * @param capacity The tables maximum capacity, which is rounded up as the
+ * sizing needs.
  * @param s The collision resoloution method to be used for the table.
+ * @param f The hash function to be used for the table.
+ * @param z How the table is sized, and so how hashes are reduced to slots.
  *
  * @return h The hash table.
  */
-htable htable_new(int capacity, hashing_t s){
-    int i = 0;
+htable htable_new(int capacity, hashing_t s, hashfn_t f, sizing_t z){
     htable h = emalloc(sizeof * h);
-    h->capacity = capacity;
     h->num_keys = 0;
     h->method = s;
-    h->freq = emalloc(h->capacity * sizeof h->freq[0]);
-    h->keys = emalloc(h->capacity * sizeof h->keys[0]);
-    h->stats = emalloc(h->capacity * sizeof h->stats[0]);
-    for(i=0;i<h->capacity;i++){
-        h->freq[i] = 0;
-        h->stats[i] = 0;
-        h->keys[i] = NULL;
-    }
+    h->hash_fn = f;
+    h->sizing = z;
+    h->max_load = HTABLE_DEFAULT_LOAD;
+    h->old = NULL;
+    h->rehash_pos = 0;
+    htable_clear_counts(h);
+    h->map = NULL;
+    h->map_len = 0;
+    h->disp = NULL;
+    h->num_buckets = 0;
+    h->seed = 0;
+    htable_alloc_slots(h, capacity);
+    h->order = emalloc(h->capacity * sizeof h->order[0]);
+    h->probe_log = emalloc(h->capacity * sizeof h->probe_log[0]);
+    h->key_store = arena_new();
     return h;
 }
 
 
 /**
  * Frees the memory which was allocated to the hash table and its
- * associated fields; stats, freq & keys.
+ * associated fields; slots & keys. The keys all live in the tables
+ * arena, so they are released a chunk at a time rather than one by one.
+ * A table loaded from an image is released by unmapping the image.
  *
  * @param h The hash table.
  */
 void htable_free(htable h){
-    int i = 0;
-    for(i=0;i<h->capacity;i++){
-        free(h->keys[i]);
+    if (h->old != NULL) {
+        free(h->old->ctrl);
+        free(h->old->slots);
+        free(h->old);
+    }
+    arena_free(h->key_store);
+    if (h->map != NULL) {
+        image_unmap(h->map, h->map_len);
+    } else {
+        free(h->probe_log);
+        free(h->ctrl);
+        free(h->slots);
+        free(h->order);
+        free(h->disp);
     }
-    free(h->keys);
-    free(h->freq);
-    free(h->stats);
     free(h);
 }
 
 
+/**
+ * Takes the slots a bucket of keys would use with a given d1, if they are
+ * all free.
+ *
+ * @param pos The slots the keys would use with a d1 of 0.
+ * @param size The number of keys.
+ * @param d1 The second part of the displacement.
+ * @param n The number of slots.
+ * @param taken The slots already used, which are added to.
+ *
+ * @return 1 if the slots were free and 0 if not.
+ */
+static int frozen_take(const unsigned int *pos, int size, unsigned int d1,
+                       unsigned int n, char *taken) {
+    unsigned int p;
+    int i;
+
+    for (i = 0; i < size; i++) {
+        p = pos[i] < n - d1 ? pos[i] + d1 : pos[i] - (n - d1);
+        if (taken[p]) {
+            break;
+        }
+        taken[p] = 1;
+    }
+    if (i == size) {
+        return 1;
+    }
+    while (i-- > 0) {
+        p = pos[i] < n - d1 ? pos[i] + d1 : pos[i] - (n - d1);
+        taken[p] = 0;
+    }
+    return 0;
+}
+
+
+/**
+ * Tries to find a displacement for every bucket of keys, so that each key
+ * lands in a slot of its own, using one hash seed. Buckets are placed
+ * largest first while the table is still mostly empty. Each displacement
+ * (d0, d1) moves a key from slot f1 to f1 + d0 * f2 + d1, and d1 runs
+ * through every slot for each d0 tried, so a bucket of one key always
+ * finds a free slot.
+ *
+ * @param h The hash table, with disp allocated for its buckets.
+ * @param g The seeded hashes of the keys, in insertion order.
+ * @param first The index into members of the first key of each bucket,
+ * with one more entry marking the end of the last bucket.
+ * @param members The keys of each bucket, by their insertion order.
+ * @param by_size The buckets, largest first.
+ * @param taken Space to mark the slots used.
+ * @param pos Space for the slots of the keys of one bucket.
+ *
+ * @return 1 if every bucket was placed and 0 if not.
+ */
+static int htable_displace(htable h, const hash_word *g, const int *first,
+                           const int *members, const int *by_size,
+                           char *taken, unsigned int *pos) {
+    unsigned int n = h->num_keys;
+    unsigned int *d;
+    const int *keys;
+    int b, i, size;
+
+    memset(taken, 0, n);
+    for (b = 0; b < h->num_buckets; b++) {
+        d = h->disp + 2 * by_size[b];
+        keys = members + first[by_size[b]];
+        size = first[by_size[b] + 1] - first[by_size[b]];
+        d[0] = d[1] = 0;
+        if (size == 0) {
+            continue;
+        }
+        for (; d[0] < FROZEN_PASSES; d[0]++) {
+            for (i = 0, d[1] = 0; i < size; i++) {
+                pos[i] = frozen_slot(g[keys[i]], d, n);
+            }
+            while (d[1] < n && !frozen_take(pos, size, d[1], n, taken)) {
+                d[1]++;
+            }
+            if (d[1] < n) {
+                break;
+            }
+        }
+        if (d[0] == FROZEN_PASSES) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * Freezes the hash table into a minimal perfect hash, for when no more
+ * words will be added. Keys are hashed into buckets, and each bucket is
+ * given a displacement which sends its keys to slots no other key uses,
+ * so the table shrinks to exactly one slot per key. Looking a word up then
+ * means hashing it, reading its buckets displacement, and comparing it
+ * with the one key in the slot that gives.
+ *
+ * Words already in a frozen table can still be counted, but new words
+ * can not be inserted. A table loaded from an image is not frozen here,
+ * though a frozen table can be saved to an image.
+ *
+ * @param h The hash table.
+ *
+ * @return 1 if the table is frozen and 0 if not.
+ */
+int htable_freeze(htable h) {
+    unsigned int n = h->num_keys;
+    struct htable_slot *slots;
+    hash_word *g;
+    int *first, *members, *by_size, *found;
+    unsigned int *pos;
+    char *taken;
+    int i, j, b, len, seed, size, max_size, frozen = 0;
+
+    htable_rehash_step(h, -1);
+    if (IS_FROZEN(h) || h->map != NULL || n == 0) {
+        return IS_FROZEN(h);
+    }
+
+    /* Find where each key is now, before the table starts to change */
+    found = emalloc(n * sizeof found[0]);
+    for (i = 0; i < (int)n; i++) {
+        len = strlen(h->order[i]);
+        found[i] = htable_probe(h, h->order[i], len,
+                                htable_word_to_int(h, h->order[i], len),
+                                NULL, NULL);
+    }
+    h->num_buckets = (n + FROZEN_BUCKET - 1) / FROZEN_BUCKET;
+    h->disp = emalloc(2 * h->num_buckets * sizeof h->disp[0]);
+    g = emalloc(n * sizeof g[0]);
+    members = emalloc(n * sizeof members[0]);
+    taken = emalloc(n);
+    pos = emalloc(n * sizeof pos[0]);
+    first = emalloc((h->num_buckets + 1) * sizeof first[0]);
+    by_size = emalloc(h->num_buckets * sizeof by_size[0]);
+
+    for (seed = 0; !frozen && seed < FROZEN_SEEDS; seed++) {
+        h->seed = WY_K1 + seed * WY_K2;
+
+        /* Sort the keys by bucket, counting how many are in each */
+        memset(first, 0, (h->num_buckets + 1) * sizeof first[0]);
+        for (i = 0; i < (int)n; i++) {
+            len = strlen(h->order[i]);
+            g[i] = hash_wymix64(h->order[i], len, h->seed);
+            first[(unsigned int)(g[i] >> 32) % h->num_buckets + 1]++;
+        }
+        for (b = 0; b < h->num_buckets; b++) {
+            first[b + 1] += first[b];
+        }
+        for (i = 0; i < (int)n; i++) {
+            b = (unsigned int)(g[i] >> 32) % h->num_buckets;
+            members[first[b]++] = i;
+        }
+        for (b = h->num_buckets; b > 0; b--) {
+            first[b] = first[b - 1];
+        }
+        first[0] = 0;
+
+        /* List the buckets largest first */
+        for (b = 0, max_size = 0; b < h->num_buckets; b++) {
+            if (first[b + 1] - first[b] > max_size) {
+                max_size = first[b + 1] - first[b];
+            }
+        }
+        for (i = 0, size = max_size; size >= 0; size--) {
+            for (b = 0; b < h->num_buckets; b++) {
+                if (first[b + 1] - first[b] == size) {
+                    by_size[i++] = b;
+                }
+            }
+        }
+        frozen = htable_displace(h, g, first, members, by_size, taken, pos);
+    }
+
+    if (frozen) {
+        slots = emalloc(n * sizeof slots[0]);
+        for (i = 0; i < (int)n; i++) {
+            b = (unsigned int)(g[i] >> 32) % h->num_buckets;
+            j = frozen_slot(g[i], h->disp + 2 * b, n);
+            slots[j] = h->slots[found[i]];
+            slots[j].hash = (unsigned int)(g[i] >> 16);
+        }
+        free(h->slots);
+        free(h->ctrl);
+        h->slots = slots;
+        h->ctrl = NULL;
+        h->capacity = n;
+    } else {
+        free(h->disp);
+        h->disp = NULL;
+        h->num_buckets = 0;
+        h->seed = 0;
+    }
+    free(g);
+    free(found);
+    free(members);
+    free(taken);
+    free(pos);
+    free(first);
+    free(by_size);
+    return frozen;
+}
+
+
+/**
+ * Saves the hash table to an image file which htable_load can map back in.
+ * The slots are written as they are, with their stored hashes and stats,
+ * so the loaded table is laid out exactly as this one is.
+ *
+ * @param h The hash table.
+ * @param filename The file to write.
+ */
+void htable_save(htable h, const char *filename) {
+    struct htable_image *im;
+    struct htable_slot *slots;
+    char **order;
+    char *image;
+    size_t size, keys;
+    int i, len, index;
+
+    htable_rehash_step(h, -1);
+    size = IMAGE_ALIGN(sizeof * im);
+    size += h->capacity * sizeof h->slots[0];
+    size += h->capacity * sizeof h->order[0];
+    size += 2 * h->num_buckets * sizeof h->disp[0];
+    size += h->ctrl != NULL ? h->capacity : 0;
+    size += h->capacity * sizeof h->probe_log[0];
+    keys = size;
+    for (i = 0; i < h->num_keys; i++) {
+        size += strlen(h->order[i]) + 1;
+    }
+    image = emalloc(size);
+    memset(image, 0, size);
+
+    im = (struct htable_image *)image;
+    im->capacity = h->capacity;
+    im->num_keys = h->num_keys;
+    im->method = h->method;
+    im->hash_fn = h->hash_fn;
+    im->sizing = h->sizing;
+    im->num_buckets = h->num_buckets;
+    im->seed = h->seed;
+    im->slots = IMAGE_ALIGN(sizeof * im);
+    im->order = im->slots + h->capacity * sizeof h->slots[0];
+    im->disp = h->disp != NULL ? im->order + h->capacity * sizeof h->order[0]
+                               : 0;
+    im->probes = im->order + h->capacity * sizeof h->order[0]
+                 + 2 * h->num_buckets * sizeof h->disp[0];
+    im->ctrl = h->ctrl != NULL ? im->probes
+                                 + h->capacity * sizeof h->probe_log[0] : 0;
+    slots = (struct htable_slot *)(image + im->slots);
+    order = (char **)(image + im->order);
+    memcpy(slots, h->slots, h->capacity * sizeof h->slots[0]);
+    if (h->disp != NULL) {
+        memcpy(image + im->disp, h->disp,
+               2 * h->num_buckets * sizeof h->disp[0]);
+    }
+    if (h->ctrl != NULL) {
+        memcpy(image + im->ctrl, h->ctrl, h->capacity);
+    }
+    memcpy(image + im->probes, h->probe_log,
+           h->num_keys * sizeof h->probe_log[0]);
+    for (i = 0; i < h->num_keys; i++) {
+        len = strlen(h->order[i]);
+        index = htable_probe(h, h->order[i], len,
+                             htable_word_to_int(h, h->order[i], len),
+                             NULL, NULL);
+        memcpy(image + keys, h->order[i], len + 1);
+        order[i] = slots[index].key = IMAGE_AT(keys);
+        keys += len + 1;
+    }
+    image_write(filename, 'H', image, size);
+    free(image);
+}
+
+
+/**
+ * Loads a hash table from an image file written by htable_save. The image
+ * is mapped and used in place, so nothing is inserted or rehashed. Words
+ * can still be added to the loaded table, but it will not grow.
+ *
+ * @param filename The file to load.
+ *
+ * @return h The hash table.
+ */
+htable htable_load(const char *filename) {
+    htable h = emalloc(sizeof * h);
+    struct htable_image *im;
+    int i;
+
+    h->map = image_map(filename, 'H', &h->map_len);
+    im = (struct htable_image *)h->map;
+    h->capacity = im->capacity;
+    h->num_keys = im->num_keys;
+    h->method = im->method;
+    h->hash_fn = im->hash_fn;
+    h->sizing = im->sizing;
+    h->slots = (struct htable_slot *)(h->map + im->slots);
+    h->order = (char **)(h->map + im->order);
+    h->ctrl = im->ctrl != 0 ? (signed char *)(h->map + im->ctrl) : NULL;
+    h->disp = im->disp != 0 ? (unsigned int *)(h->map + im->disp) : NULL;
+    h->probe_log = (int *)(h->map + im->probes);
+    h->num_buckets = im->num_buckets;
+    h->seed = im->seed;
+    if (image_moved(h->map)) {
+        for (i = 0; i < h->capacity; i++) {
+            h->slots[i].key = image_relocate(h->map, h->slots[i].key);
+        }
+        for (i = 0; i < h->num_keys; i++) {
+            h->order[i] = image_relocate(h->map, h->order[i]);
+        }
+    }
+    h->max_load = HTABLE_DEFAULT_LOAD;
+    h->old = NULL;
+    h->rehash_pos = 0;
+    htable_clear_counts(h);
+    h->key_store = arena_new();
+    return h;
+}
+
+
 /**
  * Prints the non-empty positions of the hash table
  *
@@ -122,53 +1230,138 @@ void htable_free(htable h){
  */
 void htable_print(htable h, void f(int freq, char *key)) {
     int i;
+    htable_rehash_step(h, -1);
+    for (i = 0; i < h->capacity; i++) {
+        if (h->slots[i].freq > 0) {
+            f(h->slots[i].freq, h->slots[i].key);
+        }
+    }
+}
+
+
+/**
+ * Finds the greatest common factor of two numbers.
+ *
+ * @param a The first number.
+ * @param b The second number.
+ *
+ * @return The largest number dividing both.
+ */
+static int common_factor(int a, int b) {
+    int r;
+    while (b != 0) {
+        r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+
+/**
+ * Hands every word in the hash table and its frequency to a function, along
+ * with a value of the callers choosing. The positions are visited a fixed
+ * stride apart, which shares no factor with the capacity so that each is
+ * visited once, rather than one after another. Words handed out one
+ * after another are then not in the order of their hash, which would
+ * crowd them into runs in a table using the same hash that they are
+ * inserted into.
+ *
+ * @param h The hash table.
+ * @param f The function given each word.
+ * @param arg The value passed on to f.
+ */
+void htable_each(htable h, void f(void *arg, int freq, char *key),
+                 void *arg) {
+    int i, step, pos = 0;
+    htable_rehash_step(h, -1);
+    step = (int)(h->capacity * 0.6180339887) | 1;
+    while (common_factor(h->capacity, step) != 1) {
+        step += 2;
+    }
     for (i = 0; i < h->capacity; i++) {
-        if (h->freq[i] > 0) {
-            f(h->freq[i], h->keys[i]);
+        if (h->slots[pos].freq > 0) {
+            f(arg, h->slots[pos].freq, h->slots[pos].key);
+        }
+        pos = (pos + step) % h->capacity;
+    }
+}
+
+
+/**
+ * Inserts a word into the hashtable, counting it a number of times.
+ * Note: This method will use either Linear Probing, Double hashing,
+ * Robin Hood hashing or group probing as a collision resoloution strategy
+ * depending on what is specified for the given hash table. While the table is
+ * growing, words still waiting in the old table are counted there. The
+ * number of probes a new word took to place is added to the insertion log.
+ *
+ * @param h The hash table.
+ * @param str The word to be inserted, which need not be '\0' terminated.
+ * @param len The length of the word.
+ * @param count The number of times to count the word.
+ *
+ * @return Returns the frequency of the word after it has been inserted,
+ * and 0 if the word fails to be inserted.
+ */
+int htable_insert_count(htable h, const char *str, int len, int count) {
+    unsigned int word_value = IS_FROZEN(h) ? 0
+                              : htable_word_to_int(h, str, len);
+    int index = htable_probe(h, str, len, word_value, h, NULL);
+    struct htable_slot entry;
+
+    if (index >= 0) {
+        h->slots[index].freq += count;
+        return h->slots[index].freq;
+    }
+    if (h->old != NULL) {
+        index = htable_probe(h->old, str, len, word_value, h, NULL);
+        if (index >= 0) {
+            h->old->slots[index].freq += count;
+            return h->old->slots[index].freq;
         }
+    } else if (h->num_keys >= h->capacity) {
+        return 0;
     }
+
+    entry.key = arena_strndup(h->key_store, str, len);
+    entry.hash = word_value;
+    entry.freq = count;
+    index = htable_place(h, entry);
+    h->probe_log[h->num_keys] = h->slots[index].stats;
+    h->order[h->num_keys++] = entry.key;
+    htable_rehash_step(h, HTABLE_REHASH_STEP);
+    htable_maybe_grow(h);
+    return count;
 }
 
 
 /**
  * Inserts a word into the hashtable.
- * Note: This method will use either Linear Probing or
- * Double hashing as a collision resoloution strategy depending
- * on what is specified for the given hash table.
  *
  * @param h The hash table.
- * @param str The word to be inserted.
+ * @param str The word to be inserted, which need not be '\0' terminated.
+ * @param len The length of the word.
  *
  * @return Returns 1 if the word is inserted into an empty space
  * in the table, or returns the frequency of the word if it is already been
  * inserted into the table, and 0 if the word fails to be inserted.
  */
-int htable_insert(htable h, char *str) {
-    unsigned int word_value = htable_word_to_int(str);
-    unsigned int index = word_value % h->capacity;
-    int collisions = 0;
-    unsigned int step = htable_step(h, word_value);
+int htable_insert_n(htable h, const char *str, int len) {
+    return htable_insert_count(h, str, len, 1);
+}
 
-    while(collisions < h->capacity &&
-          h->keys[index] != NULL && strcmp(h->keys[index],str) != 0){
-        index += step;
-        index = index % h->capacity;
-        collisions++;
-    }
 
-    if (NULL == h->keys[index]){
-        h->keys[index] = emalloc((strlen(str) + 1) * sizeof h->keys[0]);
-        strcpy(h->keys[index], str);
-        h->num_keys++;
-        h->freq[index]++;
-        h->stats[index] = collisions;
-        return 1;
-    } else if (strcmp(h->keys[index], str) == 0){
-        h->freq[index]++;
-        return h->freq[index];
-    } else {
-        return 0;
-    }
+/**
+ * Inserts a '\0' terminated word into the hashtable.
+ *
+ * @param h The hash table.
+ * @param str The word to be inserted.
+ *
+ * @return As for htable_insert_n.
+ */
+int htable_insert(htable h, char *str) {
+    return htable_insert_n(h, str, strlen(str));
 }
 
 
@@ -177,7 +1370,9 @@ int htable_insert(htable h, char *str) {
  *
  * @li Pos - The position in the table.
  * @li Freq - The frequency of the word.
- * @li Stats - The number of collisions that occured at this position.
+ * @li Stats - The number of collisions that occured at this position, for
+ * Robin Hood hashing how far the key now is from its home slot, or for
+ * group probing the number of full groups passed over.
  * @li Word - The word (key) stored at this position.
  *
  * @param h The hash table.
@@ -185,51 +1380,160 @@ int htable_insert(htable h, char *str) {
  */
 void htable_print_entire_table(htable h, FILE *stream){
     int i;
+    htable_rehash_step(h, -1);
     fprintf(stream, "%5s %5s %5s   %s\n", "Pos", "Freq", "Stats", "Word");
     fprintf(stream, "----------------------------------------\n");
     for(i = 0; i < h->capacity; i++) {
-        if(h->keys[i] != NULL){
-            fprintf(stream, "%5d %5d %5d   %s\n"
-                    ,i,h->freq[i],h->stats[i],h->keys[i]);
+        if(h->slots[i].key != NULL){
+            fprintf(stream, "%5d %5d %5d   %s\n",i,h->slots[i].freq,
+                    h->slots[i].stats,h->slots[i].key);
         }else{
-            fprintf(stream, "%5d %5d %5d   %s\n",i,h->freq[i],h->stats[i],"");
+            fprintf(stream, "%5d %5d %5d   %s\n",i,h->slots[i].freq,
+                    h->slots[i].stats,"");
         }
     }
 }
 
 
 /**
- * Searches for a particular key in the hash table.
+ * Searches for a particular key in the hash table, and in the table it
+ * is growing out of if a rehash is still in progress. Searching does not
+ * change the table unless it records searches, in which case the search
+ * is counted once, with the probes made in both tables.
  *
  * @param h The hash table.
- * @param The word to search for.
+ * @param str The word to search for, which need not be '\0' terminated.
+ * @param len The length of the word.
  *
  * @return Returns the frequency of the word or returns 0 if not found.
  */
-int htable_search(htable h, char *str){
-    int collisions = 0;
-    unsigned int word_value = htable_word_to_int(str);
-    unsigned int index = word_value % h->capacity;
-    unsigned int step = htable_step(h,word_value);
+int htable_search_n(htable h, const char *str, int len){
+    unsigned int word_value = IS_FROZEN(h) ? 0
+                              : htable_word_to_int(h, str, len);
+    htable tally = h->record_searches ? h : NULL;
+    int probes, more = 0, freq = 0;
+    int index = htable_probe(h, str, len, word_value, tally, &probes);
 
-    while (collisions < h->capacity) {
-        if (h->keys[index] == NULL) {
-            return 0;
-        } else if (strcmp(h->keys[index],str) == 0) {
-            return h->freq[index];
+    if (index >= 0) {
+        freq = h->slots[index].freq;
+    } else if (h->old != NULL) {
+        index = htable_probe(h->old, str, len, word_value, tally, &more);
+        if (index >= 0) {
+            freq = h->old->slots[index].freq;
         }
-        index += step;
-        index = index % h->capacity;
-        collisions++;
     }
+    count_lookup(tally, index >= 0, probes + more);
+    return freq;
+}
 
-    return 0;
+
+/**
+ * Searches for a batch of words at once. Looking a word up in a large
+ * table mostly waits on memory, first for its slot and then for its key,
+ * so rather than waiting on each word in turn all of the words are
+ * hashed and have their slots loaded into the cache together, then the
+ * keys in those slots are loaded together, and only then are the words
+ * looked for, by which time most of what they need is already there.
+ * A frozen table has its displacements loaded before its slots. The
+ * results are the same as searching for each word with htable_search_n.
+ *
+ * @param h The hash table.
+ * @param n The number of words.
+ * @param words The words, which need not be '\0' terminated.
+ * @param lens The length of each word.
+ * @param freqs Set to the frequency of each word, or 0 if it was not
+ * found.
+ */
+void htable_search_batch(htable h, int n, const char *const *words,
+                         const int *lens, int *freqs) {
+    hash_word g[HTABLE_BATCH];
+    unsigned int home[HTABLE_BATCH];
+    htable tally = h->record_searches ? h : NULL;
+    struct htable_slot *slot;
+    int i, j, m, index, probes;
+
+    for (i = 0; i < n; i += m) {
+        m = n - i < HTABLE_BATCH ? n - i : HTABLE_BATCH;
+        if (h->old != NULL) {
+            for (j = 0; j < m; j++) {
+                freqs[i + j] = htable_search_n(h, words[i + j], lens[i + j]);
+            }
+            continue;
+        }
+        for (j = 0; j < m; j++) {
+            if (IS_FROZEN(h)) {
+                g[j] = hash_wymix64(words[i + j], lens[i + j], h->seed);
+                PREFETCH(frozen_disp(h, g[j]));
+            } else {
+                g[j] = htable_word_to_int(h, words[i + j], lens[i + j]);
+                home[j] = IS_SWISS(h) ? (H1((unsigned int)g[j])
+                                         & (h->capacity / GROUP_SIZE - 1))
+                                        * GROUP_SIZE
+                          : htable_reduce(h, (unsigned int)g[j], h->capacity);
+                PREFETCH(h->slots + home[j]);
+                if (IS_SWISS(h)) {
+                    PREFETCH(h->ctrl + home[j]);
+                }
+            }
+        }
+        if (IS_FROZEN(h)) {
+            for (j = 0; j < m; j++) {
+                home[j] = frozen_slot(g[j], frozen_disp(h, g[j]),
+                                      h->capacity);
+                PREFETCH(h->slots + home[j]);
+            }
+        }
+        for (j = 0; j < m; j++) {
+            slot = &h->slots[home[j]];
+            if (slot->hash == (unsigned int)(IS_FROZEN(h) ? g[j] >> 16 : g[j])
+                && slot->key != NULL) {
+                PREFETCH(slot->key);
+            }
+        }
+        for (j = 0; j < m; j++) {
+            index = IS_FROZEN(h)
+                ? htable_frozen_probe(h, words[i + j], lens[i + j], g[j],
+                                      tally, &probes)
+                : htable_probe(h, words[i + j], lens[i + j],
+                               (unsigned int)g[j], tally, &probes);
+            freqs[i + j] = index >= 0 ? h->slots[index].freq : 0;
+            count_lookup(tally, index >= 0, probes);
+        }
+    }
+}
+
+
+/**
+ * Searches for a particular '\0' terminated key in the hash table.
+ *
+ * @param h The hash table.
+ * @param The word to search for.
+ *
+ * @return Returns the frequency of the word or returns 0 if not found.
+ */
+int htable_search(htable h, char *str){
+    return htable_search_n(h, str, strlen(str));
+}
+
+
+/**
+ * Gets the keys of the hash table in the order they were first inserted.
+ *
+ * @param h The hash table.
+ * @param i The position of the key in insertion order.
+ *
+ * @return The i'th distinct key inserted, or NULL if there are not that
+ * many keys.
+ */
+char *htable_key_in_order(htable h, int i) {
+    return i < h->num_keys ? h->order[i] : NULL;
 }
 
 
 /**
  * Prints out a line of data from the hash table to reflect the state
- * the table was in when it was a certain percentage full.
+ * the table was in when it was a certain percentage full, from the probe
+ * lengths of the keys which had been inserted by then.
  * Note: If the hashtable is less full than percent_full then no data
  * will be printed.
  *
@@ -246,13 +1550,13 @@ static void print_stats_line(htable h, FILE *stream, int percent_full) {
 
     if (current_entries > 0 && current_entries <= h->num_keys) {
         for (i = 0; i < current_entries; i++) {
-            if (h->stats[i] == 0) {
+            if (h->probe_log[i] == 0) {
                 at_home++;
             }
-            if (h->stats[i] > max_collisions) {
-                max_collisions = h->stats[i];
+            if (h->probe_log[i] > max_collisions) {
+                max_collisions = h->probe_log[i];
             }
-            average_collisions += h->stats[i];
+            average_collisions += h->probe_log[i];
         }
 
         fprintf(stream, "%4d %10d %10.1f %10.2f %11d\n", percent_full,
@@ -274,20 +1578,174 @@ static void print_stats_line(htable h, FILE *stream, int percent_full) {
  * @li Maximum Collisions - the most collisions that have occurred
  * while placing a key.
  *
+ * Keys are taken in the order they were inserted, so each line shows the
+ * table as it was when that many keys had been placed. For a table which
+ * grew, the percentage is of the size it ended up.
+ *
+ * It is followed by the number of string compares made while inserting
+ * and recorded searching, the number avoided because a slots stored hash
+ * did not match, and a histogram of how many keys were placed, and how
+ * many recorded searches found and did not find their word, with each
+ * probe length. Probe lengths no key or lookup took are left out.
+ *
  * @param h the hashtable to print statistics summary from.
  * @param stream the stream to send output to.
  * @param num_stats the maximum number of statistical snapshots to print.
  */
 void htable_print_stats(htable h, FILE *stream, int num_stats) {
-    int i;
+    long placed[PROBE_LIMIT + 1];
+    int i, longest = 0;
+    htable_rehash_step(h, -1);
 
     fprintf(stream, "\n%s\n\n",
-            h->method == LINEAR_P ? "Linear Probing" : "Double Hashing");
+            h->method == LINEAR_P ? "Linear Probing"
+            : h->method == DOUBLE_H ? "Double Hashing"
+            : h->method == ROBIN_HOOD ? "Robin Hood Hashing"
+            : "Group Probing");
     fprintf(stream, "Percent   Current   Percent    Average      Maximum\n");
     fprintf(stream, " Full     Entries   At Home   Collisions   Collisions\n");
     fprintf(stream, "-----------------------------------------------------\n");
     for (i = 1; i <= num_stats; i++) {
         print_stats_line(h, stream, 100 * i / num_stats);
     }
+    fprintf(stream, "-----------------------------------------------------\n");
+    fprintf(stream, "String compares %ld, avoided by stored hashes %ld\n\n",
+            h->compares, h->compares_skipped);
+
+    memset(placed, 0, sizeof placed);
+    for (i = 0; i < h->num_keys; i++) {
+        placed[h->probe_log[i] < PROBE_LIMIT ? h->probe_log[i]
+               : PROBE_LIMIT]++;
+    }
+    for (i = 0; i <= PROBE_LIMIT; i++) {
+        if (placed[i] > 0 || h->hits[i] > 0 || h->misses[i] > 0) {
+            longest = i;
+        }
+    }
+    fprintf(stream, "Probes        Placed   Lookup Hits   Lookup Misses\n");
+    fprintf(stream, "-----------------------------------------------------\n");
+    for (i = 0; i <= longest; i++) {
+        if (placed[i] == 0 && h->hits[i] == 0 && h->misses[i] == 0) {
+            continue;
+        }
+        fprintf(stream, "%3d%-3s %12ld %13ld %15ld\n", i,
+                i == PROBE_LIMIT ? "+" : "", placed[i], h->hits[i],
+                h->misses[i]);
+    }
     fprintf(stream, "-----------------------------------------------------\n\n");
 }
+
+
+/**
+ * Sorts a probe length into one of the buckets of the hash report, which
+ * hold lengths 0 and 1 and then each power of two range up to 64 and over.
+ *
+ * @param probes The probe length.
+ *
+ * @return The bucket.
+ */
+static int probe_bucket(int probes) {
+    int bucket = 0;
+    while (probes > 0 && bucket < 7) {
+        probes >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+
+/**
+ * Prints a report comparing each of the hash functions on the keys in the
+ * table. For each one the keys are hashed repeatedly to time it, and then
+ * inserted in their original order into a table of the same size and
+ * collision strategy to see how far they end up from home.
+ *
+ * @li ns/key - the average time to hash one key.
+ * @li MB/s - how many megabytes of keys are hashed per second.
+ * @li At Home, Average, Maximum - as for htable_print_stats.
+ *
+ * This is followed by the percentage of keys placed with each probe
+ * length, under each hash function.
+ *
+ * @param h the hashtable whose keys are used.
+ * @param stream the stream to send output to.
+ */
+void htable_print_hash_report(htable h, FILE *stream) {
+    int num_fns = sizeof hash_fns / sizeof hash_fns[0];
+    int hist[sizeof hash_fns / sizeof hash_fns[0]][8];
+    static const char *const buckets[] = {
+        "0", "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64+"
+    };
+    htable trial;
+    volatile unsigned int sink = 0;
+    double start, elapsed, bytes = 0.0, total;
+    int f, i, rounds, at_home, max;
+
+    htable_rehash_step(h, -1);
+    fprintf(stream, "\nHash functions on %d keys, %d slots, %s\n\n",
+            h->num_keys, h->capacity,
+            h->method == LINEAR_P ? "Linear Probing"
+            : h->method == DOUBLE_H ? "Double Hashing"
+            : h->method == ROBIN_HOOD ? "Robin Hood Hashing"
+            : "Group Probing");
+    fprintf(stream, "Hash       ns/key       MB/s   At Home    Average   Maximum\n");
+    fprintf(stream, "-----------------------------------------------------------\n");
+    for (i = 0; i < h->num_keys; i++) {
+        bytes += strlen(h->order[i]);
+    }
+    for (f = 0; f < num_fns; f++) {
+        rounds = 0;
+        start = get_time();
+        do {
+            for (i = 0; i < h->num_keys; i++) {
+                sink += hash_fns[f](h->order[i], strlen(h->order[i]));
+            }
+            rounds++;
+            elapsed = get_time() - start;
+        } while (elapsed < 0.05 && h->num_keys > 0);
+
+        trial = htable_new(h->capacity, h->method, f, h->sizing);
+        htable_set_max_load(trial, 0.0);
+        for (i = 0; i < h->num_keys; i++) {
+            htable_insert(trial, h->order[i]);
+        }
+        for (i = 0; i < 8; i++) {
+            hist[f][i] = 0;
+        }
+        at_home = 0;
+        max = 0;
+        total = 0.0;
+        for (i = 0; i < trial->capacity; i++) {
+            if (trial->slots[i].key != NULL) {
+                hist[f][probe_bucket(trial->slots[i].stats)]++;
+                at_home += trial->slots[i].stats == 0;
+                total += trial->slots[i].stats;
+                if (trial->slots[i].stats > max) {
+                    max = trial->slots[i].stats;
+                }
+            }
+        }
+        htable_free(trial);
+
+        fprintf(stream, "%-8s %8.2f %10.1f %9.1f %10.2f %9d\n", hash_names[f],
+                h->num_keys ? elapsed * 1e9 / rounds / h->num_keys : 0.0,
+                elapsed > 0.0 ? bytes * rounds / elapsed / 1e6 : 0.0,
+                h->num_keys ? at_home * 100.0 / h->num_keys : 0.0,
+                h->num_keys ? total / h->num_keys : 0.0, max);
+    }
+    fprintf(stream, "-----------------------------------------------------------\n");
+    fprintf(stream, "Probes  ");
+    for (f = 0; f < num_fns; f++) {
+        fprintf(stream, " %9s", hash_names[f]);
+    }
+    fprintf(stream, "\n");
+    for (i = 0; i < 8; i++) {
+        fprintf(stream, "%-8s", buckets[i]);
+        for (f = 0; f < num_fns; f++) {
+            fprintf(stream, " %8.2f%%", h->num_keys ?
+                    hist[f][i] * 100.0 / h->num_keys : 0.0);
+        }
+        fprintf(stream, "\n");
+    }
+    fprintf(stream, "-----------------------------------------------------------\n\n");
+}
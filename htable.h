@@ -13,14 +13,36 @@
 #include <stdlib.h>
 
 typedef struct htablerec *htable;
-typedef enum hashing_e { LINEAR_P, DOUBLE_H } hashing_t;
+typedef enum hashing_e {
+    LINEAR_P, DOUBLE_H, ROBIN_HOOD, SWISS
+} hashing_t;
+typedef enum hashfn_e { POLY31, FNV1A, WYMIX } hashfn_t;
+typedef enum sizing_e { PRIME_SIZE, POW2_SIZE, FAST_RANGE } sizing_t;
 
 extern void   htable_free(htable h);
+extern int    htable_freeze(htable h);
 extern int    htable_insert(htable h,char *str);
-extern htable htable_new(int capacity, hashing_t s);
+extern int    htable_insert_n(htable h, const char *str, int len);
+extern int    htable_insert_count(htable h, const char *str, int len,
+                                  int count);
+extern char  *htable_key_in_order(htable h, int i);
+extern htable htable_new(int capacity, hashing_t s, hashfn_t f,
+                         sizing_t z);
+extern htable htable_load(const char *filename);
+extern void   htable_save(htable h, const char *filename);
+extern int    htable_hash_by_name(const char *name, hashfn_t *f);
+extern int    htable_sizing_by_name(const char *name, sizing_t *z);
 extern void   htable_print(htable h, void f(int freq, char *key));
+extern void   htable_each(htable h, void f(void *arg, int freq, char *key),
+                          void *arg);
 extern void   htable_print_entire_table(htable h, FILE *stream);
 extern int    htable_search(htable h, char *str);
+extern int    htable_search_n(htable h, const char *str, int len);
+extern void   htable_search_batch(htable h, int n, const char *const *words,
+                                  const int *lens, int *freqs);
 extern void   htable_print_stats(htable h, FILE *stream, int num_stats);
+extern void   htable_record_searches(htable h);
+extern void   htable_set_max_load(htable h, double load);
+extern void   htable_print_hash_report(htable h, FILE *stream);
 
 #endif
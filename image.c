@@ -0,0 +1,152 @@
+/**
+ * Binary images of a built dictionary, which can be written to a file and
+ * mapped straight back into memory by a later run instead of building the
+ * dictionary again.
+ *
+ * An image is laid out as if it lived at IMAGE_BASE, so the pointers held
+ * inside it are ready to use when the file is mapped at that address. The
+ * mapping asks for that address but does not insist on it. If something
+ * else is already there the image is mapped elsewhere and each structure
+ * moves its own pointers along by the difference, which the private
+ * mapping allows without touching the file.
+ *
+ */
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "image.h"
+
+
+/**
+ * The version of the image layout, bumped whenever a structure saved in
+ * an image changes.
+ */
+#define IMAGE_VERSION '4'
+
+
+/**
+ * Fills in the magic number identifying an image. Images are only read
+ * back on the kind of machine that wrote them, so the magic also records
+ * the size of a pointer and the byte order.
+ *
+ * @param magic The 8 bytes of magic number.
+ * @param kind A letter for the structure the image holds.
+ */
+static void image_magic(char *magic, char kind) {
+    unsigned int one = 1;
+    magic[0] = 'A';
+    magic[1] = 'S';
+    magic[2] = 'G';
+    magic[3] = 'N';
+    magic[4] = kind;
+    magic[5] = IMAGE_VERSION;
+    magic[6] = (char)sizeof(void *);
+    magic[7] = *(char *)&one;
+}
+
+
+/**
+ * Writes an image to a file, filling in its header first.
+ *
+ * @param filename The file to write.
+ * @param kind A letter for the structure the image holds.
+ * @param image The image, which starts with an image_header.
+ * @param size The size of the image in bytes.
+ */
+void image_write(const char *filename, char kind, void *image, size_t size) {
+    struct image_header *header = image;
+    FILE *outfile;
+
+    image_magic(header->magic, kind);
+    header->size = size;
+    header->base = IMAGE_BASE;
+    if (NULL == (outfile = fopen(filename, "wb"))
+        || fwrite(image, 1, size, outfile) != size
+        || fclose(outfile) != 0) {
+        fprintf(stderr, "Can't write image %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+/**
+ * Maps an image file into memory, at IMAGE_BASE if that address is free.
+ * The mapping is private, so the structure in it can be changed without
+ * changing the file. Exits if the file is not an image of the right kind.
+ *
+ * @param filename The file to map.
+ * @param kind A letter for the structure the image should hold.
+ * @param size Set to the size of the mapping.
+ *
+ * @return The start of the mapping.
+ */
+char *image_map(const char *filename, char kind, size_t *size) {
+    struct image_header *header;
+    struct stat st;
+    char magic[8];
+    void *map = MAP_FAILED;
+    int fd;
+
+    if ((fd = open(filename, O_RDONLY)) < 0) {
+        fprintf(stderr, "Can't find file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof * header) {
+        *size = st.st_size;
+        map = mmap((void *)IMAGE_BASE, *size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    image_magic(magic, kind);
+    header = map;
+    if (map == MAP_FAILED || memcmp(header->magic, magic, 8) != 0
+        || header->size != *size) {
+        fprintf(stderr, "%s is not a usable image\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    return map;
+}
+
+
+/**
+ * Checks whether an image was mapped somewhere other than where it was
+ * laid out, in which case the pointers in it need relocating.
+ *
+ * @param map The start of the mapping.
+ *
+ * @return 1 if the image has moved and 0 if not.
+ */
+int image_moved(const char *map) {
+    return (size_t)map != ((const struct image_header *)map)->base;
+}
+
+
+/**
+ * Relocates a pointer read from an image to where the image is mapped.
+ *
+ * @param map The start of the mapping.
+ * @param p The pointer as laid out, which may be NULL.
+ *
+ * @return The pointer into the mapping, or NULL.
+ */
+void *image_relocate(const char *map, void *p) {
+    size_t base = ((const struct image_header *)map)->base;
+    return p == NULL ? NULL : (void *)(map + ((size_t)p - base));
+}
+
+
+/**
+ * Unmaps an image.
+ *
+ * @param map The start of the mapping.
+ * @param size The size of the mapping.
+ */
+void image_unmap(char *map, size_t size) {
+    munmap(map, size);
+}
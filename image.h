@@ -0,0 +1,43 @@
+/**
+ * Header file for binary dictionary images.
+ *
+ */
+#ifndef IMAGE_H_
+#define IMAGE_H_
+
+#include <stddef.h>
+
+/**
+ * The address images are laid out to be mapped at, and a pointer to a
+ * given offset into an image mapped there.
+ *
+ * @param x The offset.
+ */
+#define IMAGE_BASE ((size_t)0x2f5e0000 * (sizeof(void *) > 4 ? 0x10000 : 1))
+#define IMAGE_AT(x) ((void *)(IMAGE_BASE + (x)))
+
+/**
+ * Rounds an offset into an image up to a multiple of the alignment used
+ * for anything other than strings.
+ *
+ * @param x The offset.
+ */
+#define IMAGE_ALIGN(x) (((x) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+/**
+ * image_header struct starts every image, and is filled in by image_write.
+ */
+struct image_header {
+    char magic[8];
+    size_t size;
+    size_t base;
+};
+
+extern void   image_write(const char *filename, char kind, void *image,
+                          size_t size);
+extern char  *image_map(const char *filename, char kind, size_t *size);
+extern int    image_moved(const char *map);
+extern void  *image_relocate(const char *map, void *p);
+extern void   image_unmap(char *map, size_t size);
+
+#endif
@@ -6,14 +6,27 @@
  * @author Callan Taylor
  *
  */
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include "mylib.h"
 #include "htable.h"
 #include "tree.h"
-#include <assert.h>
-#include <ctype.h>
+#include "trie.h"
+#include "btree.h"
+#include "scanner.h"
+#include "bloom.h"
+#include "timing.h"
+#include "writer.h"
 
 
 double fill_time;
@@ -21,6 +34,148 @@ double search_time;
 int unknown_words;
 
 
+/**
+ * The number of threads used to build the dictionary and check spelling,
+ * and the starting size of the hash table each of them counts words in.
+ */
+static int num_threads = 1;
+#define SHARD_SIZE 1021
+
+
+/**
+ * The number of words of a document looked up together, and the most
+ * space a word read by the scanner takes, including its '\0'.
+ */
+#define BATCH_SIZE 16
+#define BATCH_WORD 256
+
+
+/**
+ * The most words a client sends the server in one request, and so the
+ * most bytes a request can hold, with each word followed by a newline.
+ */
+#define REQUEST_WORDS 4096
+#define REQUEST_MAX (REQUEST_WORDS * BATCH_WORD)
+
+
+/**
+ * The Bloom filter checked before the dictionary while checking spelling,
+ * the false positive rate and size in bytes it is built for (both 0 for
+ * no filter), and what it is reported with: its size, the number of words
+ * it was built from, the bits it sets for each, and the unknown words it
+ * let through.
+ */
+static bloom filter;
+static double filter_rate;
+static size_t filter_bytes;
+static size_t filter_size;
+static int filter_keys;
+static int filter_hashes;
+static long filter_passed;
+
+
+/**
+ * Whether unknown words are reported once each with the number of times
+ * they appear, instead of every time they appear, and how many distinct
+ * unknown words there were.
+ */
+static int unique_unknown;
+static int unique_words;
+
+
+/**
+ * The time spent on each phase of the run, or NULL when phases are not
+ * being timed. Each thread keeps its own timings in its shard, which are
+ * added to these once it is done, so the time of a phase is summed over
+ * every thread that worked on it.
+ */
+static timing phases;
+
+
+/**
+ * The socket the server is listening on, which is removed when the server
+ * is stopped.
+ */
+static char *server_name;
+
+
+/**
+ * word_batch struct holds words read from a document to be looked up
+ * together, and what was found for each. Each word is copied out of the
+ * scanner, which may reuse the space it handed a word out in once it is
+ * asked for the next.
+ */
+struct word_batch {
+    int n;
+    const char *word[BATCH_SIZE];
+    int len[BATCH_SIZE];
+    int freq[BATCH_SIZE];
+    char text[BATCH_SIZE][BATCH_WORD];
+};
+
+
+/**
+ * shard struct holds one piece of the input handled by a single thread.
+ * While building, the words in it are split by their hash into one part
+ * per thread, and each part is counted into its own table in counts, at
+ * the row given by id. The parts are then merged by one thread each, which
+ * adds every row of its part into the table of the first row. While checking
+ * spelling, its words are looked up in dict (or in dict_trie, dict_btree
+ * or dict_tree when dict is NULL) and the unknown ones are collected in
+ * out, to be printed in order, or counted into h when unknown words are
+ * reported once each.
+ */
+struct shard {
+    const char *buf;
+    size_t len;
+    int id;
+    htable *counts;
+    htable h;
+    htable dict;
+    tree dict_tree;
+    trie dict_trie;
+    btree dict_btree;
+    char *out;
+    size_t out_len;
+    size_t out_cap;
+    int unknown;
+    long passed;
+    timing times;
+    pthread_t thread;
+    int started;
+};
+
+
+/**
+ * merge struct holds where words counted by the threads are added: the
+ * hash table h, or whichever of r, b and t holds the dictionary when h is
+ * NULL, along with the timings the additions are recorded in and the
+ * clock they are timed by.
+ */
+struct merge {
+    htable h;
+    tree *t;
+    trie *r;
+    btree *b;
+    timing times;
+    double clock;
+};
+
+
+/**
+ * connection struct holds what the thread answering one client of the
+ * server needs: the socket it is connected on and the dictionary, held in
+ * h (or in r, b or t when h is NULL).
+ */
+struct connection {
+    int fd;
+    htable h;
+    tree t;
+    trie r;
+    btree b;
+};
+
+
 /**
  * Error checking memory allocation function ensures the all memory is
  * allocated without issues. If error is detected an error message is printed
@@ -41,87 +196,181 @@ void *emalloc(size_t s) {
 
 
 /**
- * Gets a word from input for the reading of the dictionary and document files.
+ * Error checking memory reallocation function, which exits the program if
+ * the memory cannot be allocated.
+ *
+ * @param p The memory to resize.
+ * @param s The new size of memory required.
+ *
+ * @return result A pointer to the resized memory.
+ */
+void *erealloc(void *p, size_t s) {
+    void *result = realloc(p, s);
+    if (NULL == result) {
+        fprintf(stderr, "memory allocation failed.\n");
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+
+/**
+ * Gets the time in seconds from a clock which is not affected by changes to
+ * the system time, for measuring how long something takes.
  *
- * @param s A pointer to the word to read.
- * @param limit The number of letters.
- * @param stream The input file.
+ * @return The current time.
+ */
+double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * Sets the number of threads used to build the dictionary.
  *
- * @return The number of characters left in the file.
+ * @param n The number of threads, where 1 builds it without any.
  */
-int get_word(char *s, int limit, FILE *stream){
-  int c;
-  char *w = s;
-  assert(limit > 0 && s != NULL && stream != NULL);
+void set_num_threads(int n) {
+    num_threads = n > 0 ? n : 1;
+}
+
 
-  /* skip to the start of the word */
-  while(!isalnum(c = getc(stream)) && EOF != c)
-    ;
-  if(EOF == c){
-    return EOF;
-  }else if(--limit > 0){ /* reduce limit by 1 to allow for the \0 */
-    *w++ = tolower(c);
-  }
-  while(--limit > 0){
-    if(isalnum(c = getc(stream))){
-      *w++ = tolower(c);
-    }else if('\'' == c){
-      limit++;
-    }else{
-      break;
+/**
+ * Sets the false positive rate of the Bloom filter built with the
+ * dictionary and checked before it when checking spelling.
+ *
+ * @param rate The rate, which must be between 0 and 1.
+ *
+ * @return 1 if the rate can be used and 0 if not.
+ */
+int set_filter_rate(double rate) {
+    if (rate > 0.0 && rate < 1.0) {
+        filter_rate = rate;
+        return 1;
     }
-  }
-  *w = '\0';
-  return w - s;
+    return 0;
 }
 
 
+/**
+ * Sets the size of the Bloom filter built with the dictionary and checked
+ * before it when checking spelling.
+ *
+ * @param bytes The size in bytes, which must be more than 0.
+ *
+ * @return 1 if the size can be used and 0 if not.
+ */
+int set_filter_size(long bytes) {
+    if (bytes > 0) {
+        filter_bytes = bytes;
+        return 1;
+    }
+    return 0;
+}
+
 
 /**
  * Prints out info on the ussage of the program as a whole, including all of
  * possible command line arguments.
  *
- * @param option Signals if user requires help info.
+ * @param option Signals if user requires help info: 1 if they asked for
+ * it, 2 if the options given can't be used together, which exits with
+ * failure, or 0 if they need none.
  */
 void print_help(int option) {
-    if (option == 1) {
+    if (option != 0) {
         fprintf(stderr,"Usage: ./asgn [OPTIONS]... <STDIN> \n\n\
-Perform tasks using a hash table or binary tree. By defualt, words\n\
-read from stdin are added to the data structure before printing\n\
+Perform tasks using a hash table, binary tree or trie. By defualt,\n\
+words read from stdin are added to the data structure before printing\n\
 them, along with thier frequencies, to stdout.\n\n\
- -T \t      Uses a tree data structure (default is hash table)\n\
+ -A \t      Uses a radix trie data structure (default is hash table)\n\
+ -B \t      Uses a B-tree data structure (default is hash table)\n\
+ -T \t      Uses a tree data structure (default is hash table)\n");
+        fprintf(stderr, "\
+ -C SOCKET    Check spelling of the -c document using the dictionary\n\
+              of the server listening on SOCKET\n\
+ -S SOCKET    Build the dictionary once, then serve lookups in it to\n\
+              clients on the Unix domain socket SOCKET until stopped\n");
+        fprintf(stderr, "\
+ -b RATE      Turn away unknown words with a Bloom filter letting\n\
+              through RATE of them, between 0 and 1 (if -c is used)\n");
+        fprintf(stderr, "\
  -c FILENAME  Check spelling of words in FILENAME using words\n\
               from stdin as dictionary. Print unknown words to\n\
-              stdout, timing info ect to stderr (ignore -o & -p)");
+              stdout, timing info ect to stderr (ignore -o, and\n\
+              -p unless -s is used)");
         fprintf(stderr, "\n\
  -d \t      Use double hahsing (linear probing is defualt)\n\
  -e \t      Display entire contents of hash table on stderr\n\
+ -f \t      Freeze the hash table into a perfect hash, or the tree\n\
+              into a flat array, once built\n\
+ -g \t      Use group probing, checking 16 slots at once with SIMD\n\
+ -H HASH      Hash with HASH: poly31 (defualt), fnv1a or wymix\n\
+ -i IMAGE     Load the dictionary from IMAGE instead of stdin\n\
+              (hash table or tree only)\n");
+        fprintf(stderr, "\
+ -J FILE      Time each phase of the run and write the timings as\n\
+              JSON to FILE\n");
+        fprintf(stderr, "\
+ -j THREADS   Build the dictionary and check spelling using\n\
+              THREADS threads\n\
+ -l LOAD      Grow the hash table once LOAD of it is full (default\n\
+              0.75, 0 keeps the table size fixed)\n");
+        fprintf(stderr, "\
+ -m BYTES     Make the Bloom filter BYTES bytes instead of sizing it\n\
+              for -b, which then only sets how many bits each word\n\
+              sets (if -c is used)\n");
+        fprintf(stderr, "\
  -o \t      Output the tree in DOT form to file 'tree-view.dot'\n\
  -p \t      Print hash table stats instead of frequencies & words\n\
+              (with -c, count probes of searches on one thread)\n\
+ -R \t      Use Robin Hood hashing (linear probing is defualt)\n\
  -r \t      Make the tree an RBT (defualt is BST)\n\
- -s SNAPSHOTS Show SNAPSHOTS stats snapshots (if -p is used)\n\
- -t TABLESIZE Use the first prime >= TABLESIZE as htable size\n\n\
+ -s SNAPSHOTS Show SNAPSHOTS stats snapshots (if -p is used)\n");
+        fprintf(stderr, "\
+ -t TABLESIZE Use the first prime >= TABLESIZE as htable size, or\n\
+              as -z sizes it\n\
+ -u \t      Print each unknown word once, with the number of\n\
+              times it appears (if -c is used)\n\
+ -w IMAGE     Save the dictionary to IMAGE for loading with -i\n\
+              (hash table or tree only)\n\
+ -x \t      Compare the hash functions on the dictionary (if -p\n\
+              is used)\n");
+        fprintf(stderr, "\
+ -z SIZING    Size the hash table by SIZING: prime (default), pow2\n\
+              (masking the hash) or range (scaling it, which keeps\n\
+              primes only for double hashing)\n\n\
  -h \t      Display this message\n\n");
-        exit(EXIT_SUCCESS);
+        exit(option == 1 ? EXIT_SUCCESS : EXIT_FAILURE);
     }
 }
 
 
 /**
- * Determines if the number supplied is a prime number.
+ * Determines if the number supplied is a prime number. Only 2, 3 and
+ * numbers either side of a multiple of 6 up to the square root of c can
+ * divide it first, and the search stops at the first that does.
  *
  * @param c The candidate number.
  *
  * @return 1 if c is prime 0 if not.
  */
 int is_prime(int c) {
-    int i, prime = 1;
-    for (i = 2; i < c; i++) {
-        if (c % i== 0) {
-            prime = 0;
+    int i;
+    if (c < 4) {
+        return c > 1;
+    }
+    if (c % 2 == 0 || c % 3 == 0) {
+        return 0;
+    }
+    for (i = 5; i <= c / i; i += 6) {
+        if (c % i == 0 || c % (i + 2) == 0) {
+            return 0;
         }
     }
-    return prime;
+    return 1;
 }
 
 
@@ -161,92 +410,1215 @@ FILE *open_file(char *filename) {
 
 
 
+/**
+ * Reads the next word for a loop which times its phases. When timing, the
+ * time since the clock was last read is the time taken to read the word.
+ *
+ * @param t The timings, or NULL if phases are not being timed.
+ * @param clock The time when the last phase ended, which is moved on.
+ * @param s The scanner to read from.
+ * @param word Set to the word.
+ *
+ * @return The length of the word, or EOF if there are no more words.
+ */
+static int timed_next(timing t, double *clock, scanner s, const char **word) {
+    int len = scanner_next(s, word);
+    double now;
+
+    if (t != NULL) {
+        now = get_time();
+        timing_add(t, READ_PHASE, now - *clock);
+        *clock = now;
+    }
+    return len;
+}
+
+
+/**
+ * Counts the time since the clock was last read as one operation of a
+ * phase, if phases are being timed.
+ *
+ * @param t The timings, or NULL if phases are not being timed.
+ * @param clock The time when the last phase ended, which is moved on.
+ * @param p The phase.
+ */
+static void timed_op(timing t, double *clock, phase_t p) {
+    double now;
+
+    if (t != NULL) {
+        now = get_time();
+        timing_op(t, p, now - *clock);
+        *clock = now;
+    }
+}
+
+
+/**
+ * Counts the time since the clock was last read as one batch of
+ * operations of a phase which were done together, if phases are being
+ * timed.
+ *
+ * @param t The timings, or NULL if phases are not being timed.
+ * @param clock The time when the last phase ended, which is moved on.
+ * @param p The phase.
+ * @param n The number of operations in the batch.
+ */
+static void timed_batch(timing t, double *clock, phase_t p, int n) {
+    double now;
+
+    if (t != NULL) {
+        now = get_time();
+        timing_batch(t, p, now - *clock, n);
+        *clock = now;
+    }
+}
+
+
+/**
+ * Adds the time since the clock was last read to a phase, if phases are
+ * being timed.
+ *
+ * @param t The timings, or NULL if phases are not being timed.
+ * @param clock The time when the last phase ended, which is moved on.
+ * @param p The phase.
+ */
+static void timed_span(timing t, double *clock, phase_t p) {
+    double now;
+
+    if (t != NULL) {
+        now = get_time();
+        timing_add(t, p, now - *clock);
+        *clock = now;
+    }
+}
+
+
+/**
+ * Reports each unknown word once, with the number of times it appears, in
+ * the order they first appear, instead of every time it appears.
+ */
+void set_unique_unknown(void) {
+    unique_unknown = 1;
+}
+
+
+/**
+ * Turns timing of each phase of the run on.
+ */
+void set_timing(void) {
+    if (phases == NULL) {
+        phases = timing_new();
+    }
+}
+
+
+/**
+ * Adds the time since a phase started to it, if phases are being timed.
+ *
+ * @param p The phase.
+ * @param start The time the phase started, as given by get_time.
+ */
+void add_phase_time(phase_t p, double start) {
+    timed_span(phases, &start, p);
+}
+
+
+/**
+ * Writes the timings of the run to a file as JSON, along with the fill and
+ * search times and the number of unknown words, if phases were timed.
+ *
+ * @param filename The file to write.
+ */
+void write_timing(char *filename) {
+    FILE *out;
+
+    if (phases == NULL) {
+        return;
+    }
+    if (NULL == (out = fopen(filename, "w"))) {
+        fprintf(stderr, "Can't write file %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+    fprintf(out, "{\n  \"fill_s\": %.9f,\n  \"search_s\": %.9f,\n"
+            "  \"unknown_words\": %d,\n  \"threads\": %d,\n"
+            "  \"phases\": ", fill_time, search_time, unknown_words,
+            num_threads);
+    timing_write_json(phases, out);
+    fprintf(out, "\n}\n");
+    fclose(out);
+    timing_free(phases);
+    phases = NULL;
+}
+
+
+/**
+ * Inserts a word into whichever structure holds the dictionary.
+ *
+ * @param h The hash table to insert into, or NULL to use r, b or t.
+ * @param t The tree to insert into.
+ * @param r The trie to insert into, or NULL to use b or t.
+ * @param b The B-tree to insert into, or NULL to use t.
+ * @param word The word, which need not be '\0' terminated.
+ * @param len The length of the word.
+ * @param count The number of times to count the word.
+ */
+static void insert_word(htable h, tree *t, trie *r, btree *b,
+                        const char *word, int len, int count) {
+    if (h != NULL) {
+        htable_insert_count(h, word, len, count);
+    } else if (r != NULL) {
+        *r = trie_insert_count(*r, word, len, count);
+    } else if (b != NULL) {
+        *b = btree_insert_count(*b, word, len, count);
+    } else {
+        *t = tree_insert_count(*t, word, len, count);
+    }
+}
+
+
+/**
+ * Picks which part of the dictionary a word is counted in while building
+ * with more than one thread, so that each word is always counted in the
+ * same part, by one thread.
+ *
+ * @param word The word, which need not be '\0' terminated.
+ * @param len The length of the word.
+ *
+ * @return The part, from 0 to one less than the number of threads.
+ */
+static int part_of(const char *word, int len) {
+    unsigned long hash = 2166136261UL;
+    int i;
+    for (i = 0; i < len; i++) {
+        hash = ((hash ^ (unsigned char)word[i]) * 16777619UL) & 0xffffffffUL;
+    }
+    return (int)(hash % num_threads);
+}
+
+
+/**
+ * Counts the words in one shard of the input, into one hash table for
+ * each part of the dictionary.
+ *
+ * @param arg The shard.
+ *
+ * @return NULL.
+ */
+static void *fill_shard(void *arg) {
+    struct shard *sh = arg;
+    double clock = get_time();
+    scanner s = scanner_new_mem(sh->buf, sh->len);
+    htable *parts = sh->counts + sh->id * num_threads;
+    const char *word;
+    int i, len;
+
+    for (i = 0; i < num_threads; i++) {
+        parts[i] = htable_new(SHARD_SIZE, LINEAR_P, WYMIX, POW2_SIZE);
+    }
+    while ((len = timed_next(sh->times, &clock, s, &word)) != EOF) {
+        htable_insert_n(parts[part_of(word, len)], word, len);
+        timed_op(sh->times, &clock, INSERT_PHASE);
+    }
+    scanner_free(s);
+    return NULL;
+}
+
+
+/**
+ * Adds a word counted by the threads, with its count, to where a merge is
+ * being made.
+ *
+ * @param arg The merge.
+ * @param freq The number of times the word was counted.
+ * @param key The word.
+ */
+static void merge_word(void *arg, int freq, char *key) {
+    struct merge *m = arg;
+    insert_word(m->h, m->t, m->r, m->b, key, strlen(key), freq);
+    timed_op(m->times, &m->clock, INSERT_PHASE);
+}
+
+
+/**
+ * Merges one part of the dictionary counted by every shard into the table
+ * the first shard counted it in. No other thread touches the words of
+ * this part.
+ *
+ * @param arg The shard whose id is the part to merge.
+ *
+ * @return NULL.
+ */
+static void *merge_part(void *arg) {
+    struct shard *sh = arg;
+    struct merge m;
+    int i;
+
+    m.h = sh->counts[sh->id];
+    m.t = NULL;
+    m.r = NULL;
+    m.b = NULL;
+    m.times = sh->times;
+    m.clock = get_time();
+    for (i = 1; i < num_threads; i++) {
+        htable_each(sh->counts[i * num_threads + sh->id], merge_word, &m);
+        htable_free(sh->counts[i * num_threads + sh->id]);
+        timed_span(sh->times, &m.clock, FREE_PHASE);
+    }
+    return NULL;
+}
+
+
+/**
+ * Runs a function over every shard in parallel, with one thread for each.
+ * When phases are being timed, each shard is timed on its own and its
+ * timings added to the rest once its thread is done.
+ *
+ * @param shards One shard for each thread.
+ * @param work The function to run on each shard.
+ */
+static void run_threads(struct shard *shards, void *work(void *)) {
+    int i;
+
+    for (i = 0; i < num_threads; i++) {
+        shards[i].id = i;
+        shards[i].times = phases != NULL ? timing_new() : NULL;
+        shards[i].started = pthread_create(&shards[i].thread, NULL,
+                                           work, &shards[i]) == 0;
+        if (!shards[i].started) {
+            work(&shards[i]);
+        }
+    }
+    for (i = 0; i < num_threads; i++) {
+        if (shards[i].started) {
+            pthread_join(shards[i].thread, NULL);
+        }
+        if (shards[i].times != NULL) {
+            timing_merge(phases, shards[i].times);
+            timing_free(shards[i].times);
+        }
+    }
+}
+
+
+/**
+ * Cuts the rest of the input into one shard per thread, breaking only
+ * between words, and runs a function over every shard in parallel.
+ *
+ * @param s The scanner over the input.
+ * @param shards One shard for each thread, in the same order as the input.
+ * @param work The function to run on each shard.
+ */
+static void run_shards(scanner s, struct shard *shards, void *work(void *)) {
+    size_t len, start = 0, end;
+    const char *buf = scanner_contents(s, &len);
+    int i;
+
+    for (i = 0; i < num_threads; i++) {
+        end = i + 1 == num_threads ? len : len / num_threads * (i + 1);
+        if (end < start) {
+            end = start;
+        }
+        while (end > 0 && end < len && !scanner_is_boundary(buf, end)) {
+            end++;
+        }
+        shards[i].buf = buf + start;
+        shards[i].len = end - start;
+        start = end;
+    }
+    run_threads(shards, work);
+}
+
+
+/**
+ * Inserts words from a file into whichever structure holds the dictionary
+ * and mesures the time taken. Words are scanned straight out of the file
+ * where possible. When more than one thread is used, each counts a shard
+ * of the input split into parts by the words hash, then each merges one
+ * part of every shard, so every word is counted by a single thread. The
+ * merged words are added to the structure once each, with their counts.
+ *
+ * @param stream The file to read from.
+ * @param h The hash table to insert into, or NULL to use r, b or t.
+ * @param t The tree to insert into.
+ * @param r The trie to insert into, or NULL to use b or t.
+ * @param b The B-tree to insert into, or NULL to use t.
+ */
+static void insert_words(FILE *stream, htable h, tree *t, trie *r,
+                         btree *b) {
+    double start = get_time(), clock = start;
+    scanner s = scanner_new(stream);
+    struct shard *shards;
+    struct merge m;
+    htable *counts;
+    const char *word;
+    int i, len;
+
+    timed_span(phases, &clock, READ_PHASE);
+    if (num_threads > 1) {
+        shards = emalloc(num_threads * sizeof shards[0]);
+        counts = emalloc(num_threads * num_threads * sizeof counts[0]);
+        for (i = 0; i < num_threads; i++) {
+            shards[i].counts = counts;
+        }
+        run_shards(s, shards, fill_shard);
+        run_threads(shards, merge_part);
+        m.h = h;
+        m.t = t;
+        m.r = r;
+        m.b = b;
+        m.times = phases;
+        m.clock = get_time();
+        for (i = 0; i < num_threads; i++) {
+            htable_each(counts[i], merge_word, &m);
+            htable_free(counts[i]);
+            timed_span(phases, &m.clock, FREE_PHASE);
+        }
+        free(counts);
+        free(shards);
+        clock = m.clock;
+    } else {
+        while ((len = timed_next(phases, &clock, s, &word)) != EOF) {
+            insert_word(h, t, r, b, word, len, 1);
+            timed_op(phases, &clock, INSERT_PHASE);
+        }
+    }
+    scanner_free(s);
+    timed_span(phases, &clock, FREE_PHASE);
+    fill_time = get_time() - start;
+}
+
+
 /**
  * Inserts words from a specified file into the given hashtable and mesures the
- * time taken.
+ * time taken, counting them in parallel shards as for insert_words when
+ * more than one thread is used.
  *
  * @param h The hash table to use.
  * @param infile The file to read from.
  */
 void insert_words_into_htable(htable h, FILE *infile) {
-    clock_t start, end;
-    char word[256];
-    start = clock();
-    while (get_word(word, sizeof word, infile) != EOF) {
-        htable_insert(h, word);
-    }
-    end = clock();
-    fill_time = (end - start) / (double)CLOCKS_PER_SEC;
+    insert_words(infile, h, NULL, NULL, NULL);
 }
 
 
 
 /**
  * Inserts words from a specified file into the given tree and mesures the
- * time taken.
+ * time taken, counting them in parallel shards as for insert_words when
+ * more than one thread is used.
  *
  * @param t The tree to use.
  * @param infile The file to read from.
  */
 tree insert_words_into_tree(tree t, FILE *stream) {
-    clock_t start, end;
-    char word[256];
-    start = clock();
-    while (get_word(word, sizeof word, stream) != EOF) {
-        t = tree_insert(t, word);
-    }
-    end = clock();
-    fill_time = (end - start) / (double)CLOCKS_PER_SEC;
+    insert_words(stream, NULL, &t, NULL, NULL);
+    return t;
+}
+
+
+/**
+ * Inserts words from a specified file into the given trie and mesures the
+ * time taken, counting them in parallel shards as for
+ * insert_words when more than one thread is used.
+ *
+ * @param t The trie to use.
+ * @param infile The file to read from.
+ */
+trie insert_words_into_trie(trie t, FILE *stream) {
+    insert_words(stream, NULL, NULL, &t, NULL);
     return t;
 }
 
 
+/**
+ * Inserts words from a specified file into the given B-tree and mesures the
+ * time taken, counting them in parallel shards as for
+ * insert_words when more than one thread is used.
+ *
+ * @param b The B-tree to use.
+ * @param infile The file to read from.
+ */
+btree insert_words_into_btree(btree b, FILE *stream) {
+    insert_words(stream, NULL, NULL, NULL, &b);
+    return b;
+}
+
+
+/**
+ * Loads a hash table from an image file instead of building it, and
+ * mesures the time taken.
+ *
+ * @param filename The image file.
+ *
+ * @return The hash table.
+ */
+htable load_htable(char *filename) {
+    double start = get_time();
+    htable h = htable_load(filename);
+    fill_time = get_time() - start;
+    if (phases != NULL) {
+        timing_add(phases, READ_PHASE, fill_time);
+    }
+    return h;
+}
+
+
+/**
+ * Loads a tree from an image file instead of building it, and mesures the
+ * time taken.
+ *
+ * @param filename The image file.
+ *
+ * @return The tree.
+ */
+tree load_tree(char *filename) {
+    double start = get_time();
+    tree t = tree_load(filename);
+    fill_time = get_time() - start;
+    if (phases != NULL) {
+        timing_add(phases, READ_PHASE, fill_time);
+    }
+    return t;
+}
+
+
+/**
+ * Counts a word of the dictionary towards the size of the Bloom filter.
+ *
+ * @param freq The frequency of the word.
+ * @param key The word.
+ */
+static void count_filter_key(int freq, char *key) {
+    if (freq > 0 && key != NULL) {
+        filter_keys++;
+    }
+}
+
+
+/**
+ * Adds a word of the dictionary to the Bloom filter.
+ *
+ * @param freq The frequency of the word.
+ * @param key The word.
+ */
+static void add_filter_key(int freq, char *key) {
+    if (freq > 0) {
+        bloom_add(filter, key, strlen(key));
+    }
+}
+
+
+/**
+ * Builds the Bloom filter from every word of the finished dictionary, if
+ * a false positive rate has been set, and adds the time taken to the time
+ * taken to fill the dictionary.
+ *
+ * @param h The hash table holding the dictionary, or NULL to use r, b or t.
+ * @param t The tree holding the dictionary.
+ * @param r The trie holding the dictionary, or NULL to use b or t.
+ * @param b The B-tree holding the dictionary, or NULL to use t.
+ */
+static void build_filter(htable h, tree t, trie r, btree b) {
+    double start = get_time();
+    char *key;
+    int i;
+
+    filter = NULL;
+    filter_keys = 0;
+    filter_passed = 0;
+    if (filter_rate == 0.0 && filter_bytes == 0) {
+        return;
+    }
+    if (h != NULL) {
+        while (htable_key_in_order(h, filter_keys) != NULL) {
+            filter_keys++;
+        }
+        filter = bloom_new(filter_keys, filter_rate, filter_bytes);
+        for (i = 0; (key = htable_key_in_order(h, i)); i++) {
+            bloom_add(filter, key, strlen(key));
+        }
+    } else if (r != NULL) {
+        trie_preorder(r, count_filter_key);
+        filter = bloom_new(filter_keys, filter_rate, filter_bytes);
+        trie_preorder(r, add_filter_key);
+    } else if (b != NULL) {
+        btree_preorder(b, count_filter_key);
+        filter = bloom_new(filter_keys, filter_rate, filter_bytes);
+        btree_preorder(b, add_filter_key);
+    } else {
+        tree_preorder(t, count_filter_key);
+        filter = bloom_new(filter_keys, filter_rate, filter_bytes);
+        tree_preorder(t, add_filter_key);
+    }
+    filter_size = bloom_size(filter);
+    filter_hashes = bloom_hashes(filter);
+    fill_time += get_time() - start;
+    timed_span(phases, &start, INSERT_PHASE);
+}
+
+
+/**
+ * Frees the Bloom filter once the document has been checked, keeping what
+ * is reported about it.
+ */
+static void free_filter(void) {
+    if (filter != NULL) {
+        bloom_free(filter);
+        filter = NULL;
+    }
+}
+
+
+/**
+ * Looks up a word in the dictionary, first checking the Bloom filter when
+ * there is one so that most unknown words never reach the dictionary.
+ *
+ * @param h The hash table to search, or NULL to search r, b or t.
+ * @param t The tree to search.
+ * @param r The trie to search, or NULL to search b or t.
+ * @param b The B-tree to search, or NULL to search t.
+ * @param word The word, which need not be '\0' terminated.
+ * @param len The length of the word.
+ * @param passed Counts the unknown words the filter let through.
+ *
+ * @return The frequency of the word, or 0 if it is unknown.
+ */
+static int lookup_word(htable h, tree t, trie r, btree b, const char *word,
+                       int len, long *passed) {
+    int found;
+
+    if (filter != NULL && !bloom_check(filter, word, len)) {
+        return 0;
+    }
+    if (h != NULL) {
+        found = htable_search_n(h, word, len);
+    } else if (r != NULL) {
+        found = trie_search_n(r, word, len);
+    } else if (b != NULL) {
+        found = btree_search_n(b, word, len);
+    } else {
+        found = tree_search_n(t, word, len);
+    }
+    if (filter != NULL && found == 0) {
+        (*passed)++;
+    }
+    return found;
+}
+
+
+/**
+ * Reads the next batch of words of a document, timing the reading as
+ * timed_next does.
+ *
+ * @param t The timings, or NULL if phases are not being timed.
+ * @param clock The time when the last phase ended, which is moved on.
+ * @param s The scanner to read from.
+ * @param wb The batch to fill.
+ *
+ * @return The number of words read, which is 0 at the end of the document.
+ */
+static int next_batch(timing t, double *clock, scanner s,
+                      struct word_batch *wb) {
+    const char *word;
+    int len;
+
+    for (wb->n = 0; wb->n < BATCH_SIZE; wb->n++) {
+        if ((len = timed_next(t, clock, s, &word)) == EOF) {
+            break;
+        }
+        memcpy(wb->text[wb->n], word, len);
+        wb->word[wb->n] = wb->text[wb->n];
+        wb->len[wb->n] = len;
+    }
+    return wb->n;
+}
+
+
+/**
+ * Looks up a batch of words in the dictionary, as lookup_word does for
+ * each. The words which get past the Bloom filter are looked for in a
+ * hash table together, so that it can fetch them all from memory at once.
+ *
+ * @param h The hash table to search, or NULL to search r, b or t.
+ * @param t The tree to search.
+ * @param r The trie to search, or NULL to search b or t.
+ * @param b The B-tree to search, or NULL to search t.
+ * @param wb The batch, whose frequencies are set.
+ * @param passed Counts the unknown words the filter let through.
+ */
+static void lookup_batch(htable h, tree t, trie r, btree b,
+                         struct word_batch *wb, long *passed) {
+    const char *word[BATCH_SIZE];
+    int len[BATCH_SIZE], freq[BATCH_SIZE], which[BATCH_SIZE];
+    int i, n = 0;
+
+    if (h == NULL) {
+        for (i = 0; i < wb->n; i++) {
+            wb->freq[i] = lookup_word(h, t, r, b, wb->word[i], wb->len[i],
+                                      passed);
+        }
+        return;
+    }
+    for (i = 0; i < wb->n; i++) {
+        wb->freq[i] = 0;
+        if (filter == NULL || bloom_check(filter, wb->word[i], wb->len[i])) {
+            which[n] = i;
+            word[n] = wb->word[i];
+            len[n++] = wb->len[i];
+        }
+    }
+    if (n > 0) {
+        htable_search_batch(h, n, word, len, freq);
+    }
+    for (i = 0; i < n; i++) {
+        wb->freq[which[i]] = freq[i];
+        if (filter != NULL && freq[i] == 0) {
+            (*passed)++;
+        }
+    }
+}
+
+
+/**
+ * Looks up every word of one shard of a document in the dictionary and
+ * collects the unknown ones, each on its own line.
+ *
+ * @param arg The shard.
+ *
+ * @return NULL.
+ */
+static void *check_shard(void *arg) {
+    struct shard *sh = arg;
+    double clock = get_time();
+    scanner s = scanner_new_mem(sh->buf, sh->len);
+    struct word_batch wb;
+    int i, n, len;
+
+    sh->out = NULL;
+    sh->out_len = 0;
+    sh->out_cap = 0;
+    sh->unknown = 0;
+    sh->passed = 0;
+    sh->h = unique_unknown ? htable_new(SHARD_SIZE, LINEAR_P, WYMIX,
+                                        POW2_SIZE) : NULL;
+    while ((n = next_batch(sh->times, &clock, s, &wb)) > 0) {
+        lookup_batch(sh->dict, sh->dict_tree, sh->dict_trie, sh->dict_btree,
+                     &wb, &sh->passed);
+        timed_batch(sh->times, &clock, LOOKUP_PHASE, n);
+        for (i = 0; i < n; i++) {
+            if (wb.freq[i] != 0) {
+                continue;
+            }
+            sh->unknown++;
+            if (sh->h != NULL) {
+                htable_insert_n(sh->h, wb.word[i], wb.len[i]);
+                continue;
+            }
+            len = wb.len[i];
+            if (sh->out_len + len + 1 > sh->out_cap) {
+                sh->out_cap = 2 * sh->out_cap + len + 1;
+                sh->out = erealloc(sh->out, sh->out_cap);
+            }
+            memcpy(sh->out + sh->out_len, wb.word[i], len);
+            sh->out_len += len;
+            sh->out[sh->out_len++] = '\n';
+        }
+        timed_span(sh->times, &clock, OUTPUT_PHASE);
+    }
+    scanner_free(s);
+    return NULL;
+}
+
+
+/**
+ * Checks a document against the dictionary using one shard per thread,
+ * then writes out the unknown words of each shard in document order, or
+ * adds the counts of each shards unknown words to a table in that order.
+ *
+ * @param out The writer to write unknown words to.
+ * @param unknown The table to count unknown words in, or NULL to write
+ * each one out.
+ * @param s The scanner over the document.
+ * @param h The hash table to search, or NULL to search r, b or t.
+ * @param t The tree to search.
+ * @param r The trie to search, or NULL to search b or t.
+ * @param b The B-tree to search, or NULL to search t.
+ */
+static void check_shards(writer out, htable unknown, scanner s, htable h,
+                         tree t, trie r, btree b) {
+    struct shard *shards = emalloc(num_threads * sizeof shards[0]);
+    double clock;
+    char *key;
+    int i, j, len;
+
+    for (i = 0; i < num_threads; i++) {
+        shards[i].dict = h;
+        shards[i].dict_tree = t;
+        shards[i].dict_trie = r;
+        shards[i].dict_btree = b;
+    }
+    run_shards(s, shards, check_shard);
+    clock = get_time();
+    for (i = 0; i < num_threads; i++) {
+        if (shards[i].h != NULL) {
+            for (j = 0; (key = htable_key_in_order(shards[i].h, j)); j++) {
+                len = strlen(key);
+                htable_insert_count(unknown, key, len,
+                                    htable_search_n(shards[i].h, key, len));
+            }
+            htable_free(shards[i].h);
+        }
+        if (shards[i].out_len > 0) {
+            writer_bytes(out, shards[i].out, shards[i].out_len);
+        }
+        timed_span(phases, &clock, OUTPUT_PHASE);
+        unknown_words += shards[i].unknown;
+        filter_passed += shards[i].passed;
+        free(shards[i].out);
+    }
+    free(shards);
+    timed_span(phases, &clock, FREE_PHASE);
+}
+
+
+/**
+ * Writes out each unknown word counted in a table with the number of times
+ * it appeared, in the order they first appeared, in the same form as a
+ * dictionary is printed.
+ *
+ * @param out The writer to write to.
+ * @param unknown The table the unknown words were counted in.
+ */
+static void write_unknown(writer out, htable unknown) {
+    char *key;
+
+    for (unique_words = 0;
+         (key = htable_key_in_order(unknown, unique_words)); unique_words++) {
+        writer_int(out, htable_search(unknown, key), 4);
+        writer_char(out, ' ');
+        writer_string(out, key);
+        writer_char(out, '\n');
+    }
+}
+
+
+/**
+ * Searches whichever structure holds the dictionary for all words in the
+ * input stream. If a word is not found then it increments the number of
+ * unknown words and prints that word to stdout. Mesures the time taken to
+ * find each word. Words are read and looked up in batches, which lets a
+ * hash table fetch a batch from memory at once. When more than one thread
+ * is used the document is checked in parallel shards, but unknown words
+ * are still printed in the order they appear. Unknown words are written
+ * through a buffered writer, and when they are reported once each they
+ * are counted in a table and written out at the end.
+ *
+ * @param stream The input stream containing all the words to look for.
+ * @param h The hash table to search, or NULL to search r, b or t.
+ * @param t The tree to search.
+ * @param r The trie to search, or NULL to search b or t.
+ * @param b The B-tree to search, or NULL to search t.
+ */
+static void search_words(FILE *stream, htable h, tree t, trie r, btree b) {
+    double start, clock;
+    scanner s;
+    struct word_batch wb;
+    writer out;
+    htable unknown;
+    int i, n;
+    unknown_words = 0;
+    build_filter(h, t, r, b);
+    start = get_time();
+    clock = start;
+    s = scanner_new(stream);
+    out = writer_new(stdout);
+    unknown = unique_unknown ? htable_new(SHARD_SIZE, LINEAR_P, WYMIX,
+                                          POW2_SIZE) : NULL;
+    timed_span(phases, &clock, READ_PHASE);
+    if (num_threads > 1) {
+        check_shards(out, unknown, s, h, t, r, b);
+        clock = get_time();
+    } else {
+        while ((n = next_batch(phases, &clock, s, &wb)) > 0) {
+            lookup_batch(h, t, r, b, &wb, &filter_passed);
+            timed_batch(phases, &clock, LOOKUP_PHASE, n);
+            for (i = 0; i < n; i++) {
+                if (wb.freq[i] != 0) {
+                    continue;
+                }
+                unknown_words++;
+                if (unknown != NULL) {
+                    htable_insert_n(unknown, wb.word[i], wb.len[i]);
+                } else {
+                    writer_bytes(out, wb.word[i], wb.len[i]);
+                    writer_char(out, '\n');
+                }
+            }
+            timed_span(phases, &clock, OUTPUT_PHASE);
+        }
+    }
+    if (unknown != NULL) {
+        write_unknown(out, unknown);
+        htable_free(unknown);
+    }
+    writer_free(out);
+    timed_span(phases, &clock, OUTPUT_PHASE);
+    scanner_free(s);
+    timed_span(phases, &clock, FREE_PHASE);
+    search_time = get_time() - start;
+    free_filter();
+}
+
+
 /**
  * Searches a hash table for all words in the input stream, if the words are not
  * found then it increments the number of unknown words and prints that word
- * to stdout. Mesures the time taken to find each word.
+ * to stdout. Mesures the time taken to find each word, checking in
+ * parallel shards as for search_words when more than one thread is used.
  *
  * @param h The hash table in which to seach for the words.
  * @param stream The input stream containing all the words to look for.
  */
 void search_htable(htable h, FILE *stream) {
-    clock_t start, end;
-    char word[256];
-    unknown_words = 0;
-    start = clock();
-    while (get_word(word, sizeof word, stream) != EOF) {  
-        if (htable_search(h, word) == 0) {
-            fprintf(stdout, "%s\n", word);
-            unknown_words++;
-        }
-    }
-    end = clock();
-    search_time = (end-start) / (double)CLOCKS_PER_SEC;
-    
+    search_words(stream, h, NULL, NULL, NULL);
 }
 
 
 /**
  * Searches a binary tree for all words in the input stream, if the words
  * are not found then it increments the number of unknown words and prints
- * that word to stdout. Mesures the time taken to find each word.
+ * that word to stdout. Mesures the time taken to find each word, checking
+ * in parallel shards as for search_words when more than one thread is used.
  *
  * @param h The binary treee in which to seach for the words.
  * @param stream The input stream containing all the words to look for.
  */
 void search_tree(tree t, FILE *stream) {
-    clock_t start, end;
-    char word[256];
+    search_words(stream, NULL, t, NULL, NULL);
+}
+
+
+
+/**
+ * Searches a trie for all words in the input stream, if the words are not
+ * found then it increments the number of unknown words and prints that
+ * word to stdout. Mesures the time taken to find each word, checking in
+ * parallel shards as for search_words when more than one thread is used.
+ *
+ * @param t The trie in which to seach for the words.
+ * @param stream The input stream containing all the words to look for.
+ */
+void search_trie(trie t, FILE *stream) {
+    search_words(stream, NULL, NULL, t, NULL);
+}
+
+
+
+/**
+ * Searches a B-tree for all words in the input stream, if the words are not
+ * found then it increments the number of unknown words and prints that
+ * word to stdout. Mesures the time taken to find each word, checking in
+ * parallel shards as for search_words when more than one thread is used.
+ *
+ * @param b The B-tree in which to seach for the words.
+ * @param stream The input stream containing all the words to look for.
+ */
+void search_btree(btree b, FILE *stream) {
+    search_words(stream, NULL, NULL, NULL, b);
+}
+
+
+
+/**
+ * Creates a Unix domain socket and fills in the address of a socket name.
+ *
+ * @param name The name of the socket in the file system.
+ * @param addr The address to fill in.
+ *
+ * @return The new socket, or -1 if it could not be created.
+ */
+static int socket_address(char *name, struct sockaddr_un *addr) {
+    if (strlen(name) >= sizeof addr->sun_path) {
+        fprintf(stderr, "Socket name %s is too long\n", name);
+        exit(EXIT_FAILURE);
+    }
+    memset(addr, 0, sizeof * addr);
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, name);
+    return socket(AF_UNIX, SOCK_STREAM, 0);
+}
+
+
+/**
+ * Removes the socket the server is listening on and exits, when the server
+ * is interrupted or told to stop.
+ *
+ * @param sig The signal received.
+ */
+static void stop_server(int sig) {
+    (void)sig;
+    unlink(server_name);
+    _exit(EXIT_SUCCESS);
+}
+
+
+/**
+ * Answers the requests of one client of the server until it hangs up. A
+ * request is a line holding 'F' or 'L' and the number of bytes of words
+ * which follow, each word ending in a newline. The words are looked up in
+ * batches as search_words does, and for 'F' the frequency of each word is
+ * sent back on a line of its own, while for 'L' a single line is sent back
+ * holding a '1' for each word found and a '0' for each word not. A request
+ * which is not understood ends the connection.
+ *
+ * @param arg The connection, which is freed along with its socket.
+ *
+ * @return NULL.
+ */
+static void *serve_client(void *arg) {
+    struct connection *c = arg;
+    FILE *in = fdopen(c->fd, "r");
+    writer out = writer_new_fd(c->fd);
+    char *buf = emalloc(REQUEST_MAX);
+    char line[64], kind;
+    unsigned long len;
+    double clock = 0.0;
+    long passed = 0;
+    struct word_batch wb;
+    scanner s;
+    int i, n;
+
+    while (in != NULL && fgets(line, sizeof line, in) != NULL) {
+        if (sscanf(line, "%c %lu", &kind, &len) != 2
+            || (kind != 'F' && kind != 'L') || len > REQUEST_MAX
+            || fread(buf, 1, len, in) != len
+            || (len > 0 && buf[len - 1] != '\n')) {
+            break;
+        }
+        s = scanner_new_mem(buf, len);
+        while ((n = next_batch(NULL, &clock, s, &wb)) > 0) {
+            lookup_batch(c->h, c->t, c->r, c->b, &wb, &passed);
+            for (i = 0; i < n; i++) {
+                if (kind == 'F') {
+                    writer_int(out, wb.freq[i], 0);
+                    writer_char(out, '\n');
+                } else {
+                    writer_char(out, wb.freq[i] != 0 ? '1' : '0');
+                }
+            }
+        }
+        scanner_free(s);
+        if (kind == 'L') {
+            writer_char(out, '\n');
+        }
+        if (!writer_flush(out)) {
+            break;
+        }
+    }
+    writer_free(out);
+    if (in != NULL) {
+        fclose(in);
+    } else {
+        close(c->fd);
+    }
+    free(buf);
+    free(c);
+    return NULL;
+}
+
+
+/**
+ * Listens on a Unix domain socket and answers lookups in the dictionary
+ * for any number of clients at once, each on its own thread, until the
+ * server is interrupted or told to stop. The dictionary is only searched
+ * once built, so the threads share it without locking. A socket left
+ * behind by an earlier server is replaced, but nothing else is.
+ *
+ * @param name The name of the socket in the file system.
+ * @param h The hash table to search, or NULL to search r, b or t.
+ * @param t The tree to search.
+ * @param r The trie to search, or NULL to search b or t.
+ * @param b The B-tree to search, or NULL to search t.
+ */
+static void serve_words(char *name, htable h, tree t, trie r, btree b) {
+    struct sockaddr_un addr;
+    struct connection *c;
+    struct stat st;
+    pthread_t thread;
+    int fd, client;
+
+    build_filter(h, t, r, b);
+    fd = socket_address(name, &addr);
+    if (stat(name, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(name);
+    }
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof addr) != 0
+        || listen(fd, SOMAXCONN) != 0) {
+        fprintf(stderr, "Can't listen on socket %s\n", name);
+        exit(EXIT_FAILURE);
+    }
+    server_name = name;
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, stop_server);
+    signal(SIGTERM, stop_server);
+    fprintf(stderr, "Fill time     : %f\nListening on  : %s\n", fill_time,
+            name);
+    for (;;) {
+        if ((client = accept(fd, NULL, NULL)) < 0) {
+            continue;
+        }
+        c = emalloc(sizeof * c);
+        c->fd = client;
+        c->h = h;
+        c->t = t;
+        c->r = r;
+        c->b = b;
+        if (pthread_create(&thread, NULL, serve_client, c) != 0) {
+            close(client);
+            free(c);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+
+/**
+ * Serves lookups in a hash table to clients over a Unix domain socket, as
+ * serve_words does. Never returns.
+ *
+ * @param h The hash table holding the dictionary.
+ * @param name The name of the socket in the file system.
+ */
+void serve_htable(htable h, char *name) {
+    serve_words(name, h, NULL, NULL, NULL);
+}
+
+
+/**
+ * Serves lookups in a binary tree to clients over a Unix domain socket, as
+ * serve_words does. Never returns.
+ *
+ * @param t The tree holding the dictionary.
+ * @param name The name of the socket in the file system.
+ */
+void serve_tree(tree t, char *name) {
+    serve_words(name, NULL, t, NULL, NULL);
+}
+
+
+/**
+ * Serves lookups in a trie to clients over a Unix domain socket, as
+ * serve_words does. Never returns.
+ *
+ * @param r The trie holding the dictionary.
+ * @param name The name of the socket in the file system.
+ */
+void serve_trie(trie r, char *name) {
+    serve_words(name, NULL, NULL, r, NULL);
+}
+
+
+/**
+ * Serves lookups in a B-tree to clients over a Unix domain socket, as
+ * serve_words does. Never returns.
+ *
+ * @param b The B-tree holding the dictionary.
+ * @param name The name of the socket in the file system.
+ */
+void serve_btree(btree b, char *name) {
+    serve_words(name, NULL, NULL, NULL, b);
+}
+
+
+/**
+ * Checks the spelling of all words in the input stream against the
+ * dictionary of a server listening on a Unix domain socket, printing the
+ * unknown words to stdout just as search_words does. Words are sent to
+ * the server REQUEST_WORDS at a time in 'L' requests, so there is one
+ * round trip per request rather than per word.
+ *
+ * @param name The name of the server's socket in the file system.
+ * @param stream The input stream containing all the words to look for.
+ */
+void search_server(char *name, FILE *stream) {
+    struct sockaddr_un addr;
+    size_t off[REQUEST_WORDS + 1];
+    char *words = emalloc(REQUEST_MAX);
+    char *known = emalloc(REQUEST_WORDS + 1);
+    const char *word;
+    double start, clock;
+    scanner s;
+    writer out, request;
+    htable unknown;
+    FILE *reply;
+    int fd, i, n, len;
+
     unknown_words = 0;
-    start = clock();
-    while (get_word(word, sizeof word, stream) != EOF) {
-        if (tree_search(t, word) == 0) {
-            fprintf(stdout, "%s\n", word);
+    start = get_time();
+    clock = start;
+    fd = socket_address(name, &addr);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof addr) != 0
+        || (reply = fdopen(fd, "r")) == NULL) {
+        fprintf(stderr, "Can't connect to socket %s\n", name);
+        exit(EXIT_FAILURE);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    s = scanner_new(stream);
+    out = writer_new(stdout);
+    request = writer_new_fd(fd);
+    unknown = unique_unknown ? htable_new(SHARD_SIZE, LINEAR_P, WYMIX,
+                                          POW2_SIZE) : NULL;
+    timed_span(phases, &clock, READ_PHASE);
+    for (;;) {
+        off[0] = 0;
+        for (n = 0; n < REQUEST_WORDS
+                 && (len = timed_next(phases, &clock, s, &word)) != EOF; n++) {
+            memcpy(words + off[n], word, len);
+            words[off[n] + len] = '\n';
+            off[n + 1] = off[n] + len + 1;
+        }
+        if (n == 0) {
+            break;
+        }
+        writer_string(request, "L ");
+        writer_int(request, (int)off[n], 0);
+        writer_char(request, '\n');
+        writer_bytes(request, words, off[n]);
+        if (!writer_flush(request)
+            || fread(known, 1, n + 1, reply) != (size_t)n + 1
+            || known[n] != '\n') {
+            fprintf(stderr, "Lost connection to socket %s\n", name);
+            exit(EXIT_FAILURE);
+        }
+        timed_batch(phases, &clock, LOOKUP_PHASE, n);
+        for (i = 0; i < n; i++) {
+            if (known[i] != '0') {
+                continue;
+            }
             unknown_words++;
+            len = off[i + 1] - off[i] - 1;
+            if (unknown != NULL) {
+                htable_insert_n(unknown, words + off[i], len);
+            } else {
+                writer_bytes(out, words + off[i], len + 1);
+            }
         }
+        timed_span(phases, &clock, OUTPUT_PHASE);
+    }
+    if (unknown != NULL) {
+        write_unknown(out, unknown);
+        htable_free(unknown);
     }
-    end = clock();
-    search_time = (end - start) / (double)CLOCKS_PER_SEC;
+    writer_free(out);
+    timed_span(phases, &clock, OUTPUT_PHASE);
+    writer_free(request);
+    fclose(reply);
+    scanner_free(s);
+    free(words);
+    free(known);
+    timed_span(phases, &clock, FREE_PHASE);
+    search_time = get_time() - start;
 }
 
 
@@ -259,5 +1631,20 @@ void print_basic_stats() {
     fprintf(stderr,
             "Fill time     : %f\nSearch time   : %f\nUnknown words = %d\n",
             fill_time, search_time,unknown_words);
+    if (unique_unknown) {
+        fprintf(stderr, "Unique words  = %d\n", unique_words);
+    }
+    if (filter_keys > 0) {
+        fprintf(stderr, "Filter size   : %lu bytes (%.1f bits per word, "
+                "%d hashes)\n", (unsigned long)filter_size,
+                8.0 * filter_size / filter_keys, filter_hashes);
+        fprintf(stderr, "Filter rate   : %f",
+                unknown_words > 0 ? (double)filter_passed / unknown_words
+                : 0.0);
+        if (filter_rate > 0.0) {
+            fprintf(stderr, " (target %f)", filter_rate);
+        }
+        fprintf(stderr, "\n");
+    }
    
 }
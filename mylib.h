@@ -13,20 +13,41 @@
 #include <stdlib.h>
 #include "htable.h"
 #include "tree.h"
+#include "trie.h"
+#include "btree.h"
+#include "timing.h"
 #include <stdio.h>
 
 
 extern void   *emalloc(size_t s);
 extern void   *erealloc(void *p, size_t s);
 extern void   print_help(int option);
+extern void   set_num_threads(int n);
+extern int    set_filter_rate(double rate);
+extern int    set_filter_size(long bytes);
+extern void   set_timing(void);
+extern void   set_unique_unknown(void);
+extern void   add_phase_time(phase_t p, double start);
+extern void   write_timing(char *filename);
+extern double get_time(void);
 extern int    is_prime(int c);
 extern int    get_next_prime(int size);
 extern FILE   *open_file(char *filename);
-extern int    get_word(char *s, int limit, FILE *stream);
 extern void   insert_words_into_htable(htable h, FILE *infile);
 extern tree   insert_words_into_tree(tree t, FILE *infile);
+extern trie   insert_words_into_trie(trie t, FILE *infile);
+extern btree  insert_words_into_btree(btree b, FILE *infile);
+extern htable load_htable(char *filename);
+extern tree   load_tree(char *filename);
 extern void   search_tree(tree t, FILE *stream);
 extern void   search_htable(htable h, FILE *stream);
+extern void   search_trie(trie t, FILE *stream);
+extern void   search_btree(btree b, FILE *stream);
+extern void   serve_htable(htable h, char *name);
+extern void   serve_tree(tree t, char *name);
+extern void   serve_trie(trie r, char *name);
+extern void   serve_btree(btree b, char *name);
+extern void   search_server(char *name, FILE *stream);
 extern void   print_basic_stats();
 
 #endif
@@ -0,0 +1,511 @@
+/**
+ * A word scanner which splits a file into words, each a run of letters and
+ * digits folded to lower case with any apostrophes inside it dropped, and
+ * hands them out as (pointer, length) views instead of copying each one.
+ * Regular files are memory mapped and most words are returned straight out
+ * of the mapping. Anything else, such as a pipe, is read through a large
+ * buffer instead. A scanner can also be run over a block of memory, which
+ * lets the input be cut into pieces and scanned by several threads.
+ *
+ * Finding where words start and end and folding them to lower case is
+ * done 32 or 16 bytes at a time with AVX2 or SSE2 where the processor has
+ * them, chosen when the scanner is created, and a byte at a time otherwise.
+ *
+ */
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "scanner.h"
+#include "mylib.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCANNER_X86
+#include <immintrin.h>
+#endif
+
+
+/**
+ * The longest word handed out, which leaves room for a '\0' in a 256 byte
+ * buffer, and the read size used for streams.
+ */
+#define SCANNER_MAX_WORD 255
+#define SCANNER_BUFSIZE (1 << 16)
+
+
+/**
+ * Macros for classifying a character of input, which agree with isalnum,
+ * islower and isdigit in the "C" locale.
+ *
+ * @param c The character.
+ */
+#define IN_RANGE(c, lo, hi) ((unsigned char)((c) - (lo)) <= (hi) - (lo))
+#define IS_FOLDED_CHAR(c) (IN_RANGE(c, 'a', 'z') || IN_RANGE(c, '0', '9'))
+#define IS_WORD_CHAR(c) (IS_FOLDED_CHAR(c) || IN_RANGE(c, 'A', 'Z'))
+#define FOLD(c) (IN_RANGE(c, 'A', 'Z') ? (c) + ('a' - 'A') : (c))
+
+
+/**
+ * scan_ops struct holds the functions which do the byte by byte work of
+ * scanning, so that a version for the processor can be picked at run time.
+ *
+ * @li skip - counts the leading bytes which are not letters or digits.
+ * @li span - counts the leading bytes which are lower case letters or
+ * digits.
+ * @li fold - copies the leading letters and digits to dst in lower case,
+ * returning how many there were.
+ */
+struct scan_ops {
+    size_t (*skip)(const char *p, size_t n);
+    size_t (*span)(const char *p, size_t n);
+    size_t (*fold)(char *dst, const char *p, size_t n);
+};
+
+
+/**
+ * Counts the leading bytes of a block which cannot start a word.
+ *
+ * @param p The start of the block.
+ * @param n The length of the block.
+ *
+ * @return The number of bytes before the first letter or digit.
+ */
+static size_t skip_scalar(const char *p, size_t n) {
+    size_t i = 0;
+    while (i < n && !IS_WORD_CHAR(p[i])) {
+        i++;
+    }
+    return i;
+}
+
+
+/**
+ * Counts the leading bytes of a block which are already in folded form.
+ *
+ * @param p The start of the block.
+ * @param n The length of the block.
+ *
+ * @return The number of bytes before the first byte which is not a lower
+ * case letter or digit.
+ */
+static size_t span_scalar(const char *p, size_t n) {
+    size_t i = 0;
+    while (i < n && IS_FOLDED_CHAR(p[i])) {
+        i++;
+    }
+    return i;
+}
+
+
+/**
+ * Copies the leading letters and digits of a block in lower case.
+ *
+ * @param dst Where to copy them to, which must have room for n bytes.
+ * @param p The start of the block.
+ * @param n The length of the block.
+ *
+ * @return The number of bytes copied.
+ */
+static size_t fold_scalar(char *dst, const char *p, size_t n) {
+    size_t i = 0;
+    while (i < n && IS_WORD_CHAR(p[i])) {
+        dst[i] = FOLD(p[i]);
+        i++;
+    }
+    return i;
+}
+
+
+static const struct scan_ops scalar_ops = {
+    skip_scalar, span_scalar, fold_scalar
+};
+
+
+#ifdef SCANNER_X86
+
+/**
+ * Marks the bytes of a vector which lie in a range of characters, using a
+ * signed compare after shifting the range down to start at -128.
+ *
+ * @param x The bytes.
+ * @param lo The first character in the range.
+ * @param hi The last character in the range.
+ *
+ * @return A vector with every byte in the range set to all ones.
+ */
+#define SSE2_IN_RANGE(x, lo, hi) \
+    _mm_cmplt_epi8(_mm_add_epi8((x), _mm_set1_epi8((char)(0x80 - (lo)))), \
+                   _mm_set1_epi8((char)(0x80 + (hi) - (lo) + 1)))
+#define AVX2_IN_RANGE(x, lo, hi) \
+    _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(0x80 + (hi) - (lo) + 1)), \
+                      _mm256_add_epi8((x), \
+                                      _mm256_set1_epi8((char)(0x80 - (lo)))))
+
+
+__attribute__((target("sse2")))
+static size_t skip_sse2(const char *p, size_t n) {
+    size_t i = 0;
+    __m128i x;
+    unsigned int mask;
+
+    for (; i + 16 <= n; i += 16) {
+        x = _mm_loadu_si128((const __m128i *)(p + i));
+        mask = _mm_movemask_epi8(_mm_or_si128(
+                   _mm_or_si128(SSE2_IN_RANGE(x, 'a', 'z'),
+                                SSE2_IN_RANGE(x, 'A', 'Z')),
+                   SSE2_IN_RANGE(x, '0', '9')));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + skip_scalar(p + i, n - i);
+}
+
+
+__attribute__((target("sse2")))
+static size_t span_sse2(const char *p, size_t n) {
+    size_t i = 0;
+    __m128i x;
+    unsigned int mask;
+
+    for (; i + 16 <= n; i += 16) {
+        x = _mm_loadu_si128((const __m128i *)(p + i));
+        mask = _mm_movemask_epi8(_mm_or_si128(SSE2_IN_RANGE(x, 'a', 'z'),
+                                              SSE2_IN_RANGE(x, '0', '9')));
+        if (mask != 0xffff) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i + span_scalar(p + i, n - i);
+}
+
+
+__attribute__((target("sse2")))
+static size_t fold_sse2(char *dst, const char *p, size_t n) {
+    size_t i = 0;
+    __m128i x, upper;
+    unsigned int mask;
+
+    for (; i + 16 <= n; i += 16) {
+        x = _mm_loadu_si128((const __m128i *)(p + i));
+        upper = SSE2_IN_RANGE(x, 'A', 'Z');
+        mask = _mm_movemask_epi8(_mm_or_si128(
+                   _mm_or_si128(SSE2_IN_RANGE(x, 'a', 'z'), upper),
+                   SSE2_IN_RANGE(x, '0', '9')));
+        x = _mm_add_epi8(x, _mm_and_si128(upper, _mm_set1_epi8('a' - 'A')));
+        _mm_storeu_si128((__m128i *)(dst + i), x);
+        if (mask != 0xffff) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i + fold_scalar(dst + i, p + i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static size_t skip_avx2(const char *p, size_t n) {
+    size_t i = 0;
+    __m256i x;
+    unsigned int mask;
+
+    for (; i + 32 <= n; i += 32) {
+        x = _mm256_loadu_si256((const __m256i *)(p + i));
+        mask = _mm256_movemask_epi8(_mm256_or_si256(
+                   _mm256_or_si256(AVX2_IN_RANGE(x, 'a', 'z'),
+                                   AVX2_IN_RANGE(x, 'A', 'Z')),
+                   AVX2_IN_RANGE(x, '0', '9')));
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+    return i + skip_sse2(p + i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static size_t span_avx2(const char *p, size_t n) {
+    size_t i = 0;
+    __m256i x;
+    unsigned int mask;
+
+    for (; i + 32 <= n; i += 32) {
+        x = _mm256_loadu_si256((const __m256i *)(p + i));
+        mask = _mm256_movemask_epi8(_mm256_or_si256(
+                   AVX2_IN_RANGE(x, 'a', 'z'), AVX2_IN_RANGE(x, '0', '9')));
+        if (mask != 0xffffffffU) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i + span_sse2(p + i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static size_t fold_avx2(char *dst, const char *p, size_t n) {
+    size_t i = 0;
+    __m256i x, upper;
+    unsigned int mask;
+
+    for (; i + 32 <= n; i += 32) {
+        x = _mm256_loadu_si256((const __m256i *)(p + i));
+        upper = AVX2_IN_RANGE(x, 'A', 'Z');
+        mask = _mm256_movemask_epi8(_mm256_or_si256(
+                   _mm256_or_si256(AVX2_IN_RANGE(x, 'a', 'z'), upper),
+                   AVX2_IN_RANGE(x, '0', '9')));
+        x = _mm256_add_epi8(x, _mm256_and_si256(upper,
+                                                _mm256_set1_epi8('a' - 'A')));
+        _mm256_storeu_si256((__m256i *)(dst + i), x);
+        if (mask != 0xffffffffU) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i + fold_sse2(dst + i, p + i, n - i);
+}
+
+
+static const struct scan_ops sse2_ops = { skip_sse2, span_sse2, fold_sse2 };
+static const struct scan_ops avx2_ops = { skip_avx2, span_avx2, fold_avx2 };
+
+#endif
+
+
+/**
+ * Picks the fastest scanning functions the processor supports.
+ *
+ * @return The scanning functions.
+ */
+static const struct scan_ops *scan_ops_select(void) {
+#ifdef SCANNER_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return &avx2_ops;
+    } else if (__builtin_cpu_supports("sse2")) {
+        return &sse2_ops;
+    }
+#endif
+    return &scalar_ops;
+}
+
+
+/**
+ * scannerrec struct is the blueprint for creating an instance of a scanner.
+ */
+struct scannerrec {
+    char *buf;
+    size_t pos;
+    size_t len;
+    FILE *stream;
+    int owns_buf;
+    void *map;
+    size_t map_len;
+    const struct scan_ops *ops;
+    char word[SCANNER_MAX_WORD + 1];
+};
+
+
+/**
+ * Creates a scanner over a stream. If the stream is a regular file the
+ * rest of it is memory mapped, otherwise it is read in large blocks.
+ *
+ * @param stream The stream to read words from.
+ *
+ * @return s The new scanner.
+ */
+scanner scanner_new(FILE *stream) {
+    scanner s = emalloc(sizeof * s);
+    struct stat st;
+    long offset = ftell(stream);
+
+    s->stream = NULL;
+    s->owns_buf = 0;
+    s->map = NULL;
+    s->pos = 0;
+    s->len = 0;
+    s->ops = scan_ops_select();
+    if (offset >= 0 && fstat(fileno(stream), &st) == 0
+        && S_ISREG(st.st_mode) && st.st_size > offset) {
+        s->map_len = st.st_size;
+        s->map = mmap(NULL, s->map_len, PROT_READ, MAP_PRIVATE,
+                      fileno(stream), 0);
+        if (MAP_FAILED == s->map) {
+            s->map = NULL;
+        }
+    }
+    if (s->map != NULL) {
+        posix_madvise(s->map, s->map_len, POSIX_MADV_SEQUENTIAL);
+        s->buf = s->map;
+        s->pos = offset;
+        s->len = s->map_len;
+    } else {
+        s->stream = stream;
+        s->owns_buf = 1;
+        s->buf = emalloc(SCANNER_BUFSIZE);
+    }
+    return s;
+}
+
+
+/**
+ * Creates a scanner over a block of memory, which must not start or end
+ * part way through a word and must stay valid until the scanner is freed.
+ *
+ * @param buf The start of the block.
+ * @param len The length of the block.
+ *
+ * @return s The new scanner.
+ */
+scanner scanner_new_mem(const char *buf, size_t len) {
+    scanner s = emalloc(sizeof * s);
+    s->buf = (char *)buf;
+    s->pos = 0;
+    s->len = len;
+    s->stream = NULL;
+    s->owns_buf = 0;
+    s->map = NULL;
+    s->ops = scan_ops_select();
+    return s;
+}
+
+
+/**
+ * Gets the rest of the input as a single block of memory. A mapped file is
+ * returned as it is, while a stream is read in to the end.
+ *
+ * @param s The scanner.
+ * @param len Set to the length of the block.
+ *
+ * @return The start of the block, which stays valid until the scanner is
+ * freed.
+ */
+const char *scanner_contents(scanner s, size_t *len) {
+    size_t cap = SCANNER_BUFSIZE;
+    size_t n;
+
+    if (s->stream != NULL) {
+        s->len -= s->pos;
+        memmove(s->buf, s->buf + s->pos, s->len);
+        s->pos = 0;
+        do {
+            if (s->len == cap) {
+                cap *= 2;
+                s->buf = erealloc(s->buf, cap);
+            }
+            n = fread(s->buf + s->len, 1, cap - s->len, s->stream);
+            s->len += n;
+        } while (n > 0);
+        s->stream = NULL;
+    }
+    *len = s->len - s->pos;
+    return s->buf + s->pos;
+}
+
+
+/**
+ * Checks whether a point in a block of memory falls between two words, so
+ * that the block can be cut there without changing the words in it.
+ *
+ * @param buf The start of the block.
+ * @param pos The point to check, greater than 0.
+ *
+ * @return 1 if no word runs across pos, 0 if one does.
+ */
+int scanner_is_boundary(const char *buf, size_t pos) {
+    return !IS_WORD_CHAR(buf[pos - 1]) && '\'' != buf[pos - 1];
+}
+
+
+/**
+ * Reads the next block of a stream into the buffer.
+ *
+ * @param s The scanner.
+ *
+ * @return 1 if there is more input, 0 at the end of the input.
+ */
+static int scanner_refill(scanner s) {
+    if (NULL == s->stream) {
+        return 0;
+    }
+    s->pos = 0;
+    s->len = fread(s->buf, 1, SCANNER_BUFSIZE, s->stream);
+    return s->len > 0;
+}
+
+
+/**
+ * Gets the next word from the input. Letters and digits are folded to
+ * lower case, apostrophes inside a word are dropped and a word is cut off
+ * after 255 characters.
+ * A word which is already in that form and lies wholly inside the current
+ * block is returned in place, anything else is built up in the scanner.
+ *
+ * @param s The scanner.
+ * @param word Set to point at the word, which is not '\0' terminated and
+ * stays valid until the next call.
+ *
+ * @return The length of the word, or EOF at the end of the input.
+ */
+int scanner_next(scanner s, const char **word) {
+    size_t start, n, k;
+
+    /* skip to the start of the word */
+    for (;;) {
+        s->pos += s->ops->skip(s->buf + s->pos, s->len - s->pos);
+        if (s->pos < s->len) {
+            break;
+        } else if (!scanner_refill(s)) {
+            return EOF;
+        }
+    }
+
+    /* words already in folded form are handed out in place */
+    start = s->pos;
+    n = s->len - s->pos;
+    n = s->ops->span(s->buf + start, n < SCANNER_MAX_WORD
+                     ? n : SCANNER_MAX_WORD);
+    s->pos += n;
+    if (n == SCANNER_MAX_WORD || (s->pos == s->len && NULL == s->stream)
+        || (s->pos < s->len && !IS_WORD_CHAR(s->buf[s->pos])
+            && '\'' != s->buf[s->pos])) {
+        *word = s->buf + start;
+        return n;
+    }
+
+    /* otherwise fold the rest of the word into our own buffer */
+    memcpy(s->word, s->buf + start, n);
+    while (n < SCANNER_MAX_WORD) {
+        if (s->pos == s->len && !scanner_refill(s)) {
+            break;
+        }
+        k = s->len - s->pos < SCANNER_MAX_WORD - n
+            ? s->len - s->pos : SCANNER_MAX_WORD - n;
+        k = s->ops->fold(s->word + n, s->buf + s->pos, k);
+        n += k;
+        s->pos += k;
+        if (n == SCANNER_MAX_WORD || s->pos == s->len) {
+            continue;
+        } else if ('\'' == s->buf[s->pos++]) {
+            continue;
+        }
+        break;
+    }
+    *word = s->word;
+    return n;
+}
+
+
+/**
+ * Frees the memory and any file mapping held by a scanner. The stream or
+ * block of memory it was reading from is left alone.
+ *
+ * @param s The scanner.
+ */
+void scanner_free(scanner s) {
+    if (s->map != NULL) {
+        munmap(s->map, s->map_len);
+    } else if (s->owns_buf) {
+        free(s->buf);
+    }
+    free(s);
+}
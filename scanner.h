@@ -0,0 +1,19 @@
+/**
+ * Header file for word scanner implementation.
+ *
+ */
+#ifndef SCANNER_H_
+#define SCANNER_H_
+
+#include <stdio.h>
+
+typedef struct scannerrec *scanner;
+
+extern scanner scanner_new(FILE *stream);
+extern scanner scanner_new_mem(const char *buf, size_t len);
+extern const char *scanner_contents(scanner s, size_t *len);
+extern int     scanner_is_boundary(const char *buf, size_t pos);
+extern int     scanner_next(scanner s, const char **word);
+extern void    scanner_free(scanner s);
+
+#endif
@@ -0,0 +1,126 @@
+#!/bin/sh
+# Checks that every dictionary structure and option gives the same output
+# as the plain hash table: the words and frequencies printed, the unknown
+# words of a spell check, images saved with -w and loaded with -i, and
+# spell checks made through a server with -S and -C. The dictionary and
+# document are made up each run from a fixed seed, so no data is needed.
+#
+# Run from the top of the source tree with:
+#    make check
+# or give the program to check:
+#    sh tests/check.sh ./asgn
+
+asgn=${1:-./asgn}
+case "$asgn" in /*) ;; *) asgn=$(pwd)/$asgn ;; esac
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1
+failed=0
+
+fail() {
+    echo "FAIL: $*"
+    failed=1
+}
+
+# Makes up words from a small alphabet with a linear congruential generator
+# which only needs small whole numbers, so every awk gives the same words.
+# Short words come up often and long ones rarely, so the dictionary has
+# words of many frequencies. About a quarter of the words of the document
+# are misspelt with a letter the dictionary never uses, and some are
+# capitalised or followed by punctuation.
+words() {
+    awk -v seed="$1" -v n="$2" -v doc="$3" 'BEGIN {
+        letters = "etaoinshrdlu"; x = seed
+        for (i = 0; i < n; i++) {
+            x = (x * 75 + 74) % 65537
+            len = 2 + x % 6
+            w = ""
+            for (j = 0; j < len; j++) {
+                x = (x * 75 + 74) % 65537
+                w = w substr(letters, 1 + x % 12, 1)
+            }
+            if (doc && x % 4 == 0) {
+                w = substr(w, 1, 1) "z" substr(w, 2)
+            }
+            if (doc && x % 7 == 0) {
+                w = toupper(substr(w, 1, 1)) substr(w, 2)
+            }
+            if (doc && x % 5 == 0) {
+                w = w ","
+            }
+            printf "%s%s", w, (i % 10 == 9) ? "\n" : " "
+        }
+        printf "\n"
+    }'
+}
+
+words 1 20000 0 > dict.txt
+words 2 10000 1 > doc.txt
+
+"$asgn" < dict.txt | sort > dump.ref
+"$asgn" -c doc.txt < dict.txt > check.ref 2> /dev/null
+"$asgn" -u -c doc.txt < dict.txt > unique.ref 2> /dev/null
+[ -s dump.ref ] || fail "no dictionary printed"
+[ -s check.ref ] || fail "no unknown words found"
+
+# Every structure and option against the plain hash table
+for opts in "-d" "-R" "-g" "-f" "-d -f" "-H fnv1a" "-H wymix" "-z pow2" \
+            "-z range" "-d -z range" "-l 0 -t 50000" "-j 3" "-b 0.05" \
+            "-m 4096" "-m 4096 -b 0.01" \
+            "-T" "-T -r" "-T -f" "-T -j 3" "-A" "-A -j 3" "-B" "-B -j 3"; do
+    "$asgn" $opts < dict.txt | sort > dump.out
+    cmp -s dump.ref dump.out || fail "dictionary printed with $opts"
+    "$asgn" $opts -c doc.txt < dict.txt > check.out 2> /dev/null
+    cmp -s check.ref check.out || fail "spell check with $opts"
+    "$asgn" $opts -u -c doc.txt < dict.txt > unique.out 2> /dev/null
+    cmp -s unique.ref unique.out || fail "spell check with $opts -u"
+done
+
+# Images saved with -w and loaded back with -i
+for opts in "" "-d" "-R" "-g" "-f" "-z pow2" "-T" "-T -r" "-T -f"; do
+    "$asgn" $opts -w image.bin < dict.txt > saved.out
+    "$asgn" $opts -i image.bin < /dev/null > loaded.out
+    cmp -s saved.out loaded.out || fail "image round trip with $opts"
+    "$asgn" $opts -i image.bin -c doc.txt > check.out 2> /dev/null
+    cmp -s check.ref check.out || fail "spell check of image with $opts"
+done
+
+# A table loaded from an unfrozen image can't be frozen, which is reported
+"$asgn" -w image.bin < dict.txt > /dev/null
+"$asgn" -f -i image.bin 2>&1 > /dev/null < /dev/null | grep -q freeze ||
+    fail "no warning that a loaded table was left unfrozen"
+
+# Options the trie and B-tree can't honour, and filter rates and sizes
+# which make no sense, are refused
+for opts in "-A -w image.bin" "-A -i image.bin" "-A -f" "-A -o" \
+            "-B -w image.bin" "-B -i image.bin" "-B -f" "-b 0" "-b 1" \
+            "-b rate" "-b 0.1x" "-m 0" "-m 4k"; do
+    "$asgn" $opts < dict.txt > /dev/null 2>&1 && fail "accepted $opts"
+done
+
+# Spell checks made by several clients at once through a server
+for opts in "" "-T" "-A" "-B" "-f" "-b 0.05"; do
+    "$asgn" $opts -S server.sock < dict.txt 2> /dev/null &
+    server=$!
+    tries=0
+    while [ ! -S server.sock ] && [ $tries -lt 30 ]; do
+        sleep 1
+        tries=$((tries + 1))
+    done
+    "$asgn" -C server.sock -c doc.txt > client1.out 2> /dev/null &
+    client=$!
+    "$asgn" -C server.sock -c doc.txt > client2.out 2> /dev/null
+    "$asgn" -u -C server.sock -c doc.txt > client3.out 2> /dev/null
+    wait $client
+    kill $server
+    wait $server
+    cmp -s check.ref client1.out || fail "client of server with $opts"
+    cmp -s check.ref client2.out || fail "client of server with $opts"
+    cmp -s unique.ref client3.out || fail "client of server with $opts -u"
+    [ -e server.sock ] && fail "socket left behind with $opts"
+done
+
+if [ $failed -eq 0 ]; then
+    echo "All checks passed"
+fi
+exit $failed
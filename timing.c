@@ -0,0 +1,314 @@
+/**
+ * Timings of each phase of a run: reading and splitting the input into
+ * words, inserting them, looking them up, writing output and freeing
+ * memory. Each phase has a total time, and phases made of single
+ * operations also keep a histogram of how long each one took, so that the
+ * tail of the latencies can be seen as well as the mean. Operations done
+ * together in batches, such as batched lookups, are only timed a batch at
+ * a time, and so have a histogram of how long each batch took instead.
+ * A histogram has four buckets for every power of two nanoseconds, which
+ * keeps it small enough to update on every operation while being
+ * accurate to within 25%.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "timing.h"
+#include "mylib.h"
+
+
+/**
+ * The number of buckets in a histogram, which is enough for any latency
+ * up to 2^32 ns.
+ */
+#define TIMING_BUCKETS 128
+
+
+/**
+ * The names phases are written out by.
+ */
+static const char *phase_names[] = {
+    "read", "insert", "lookup", "output", "free"
+};
+
+
+/**
+ * timing_hist struct holds the latencies of one kind of thing timed: how
+ * many there were, the time they took between them, the longest of them
+ * and how many fell into each bucket of the histogram.
+ */
+struct timing_hist {
+    long count;
+    double seconds;
+    double max_ns;
+    long bucket[TIMING_BUCKETS];
+};
+
+
+/**
+ * timingrec struct is the blueprint for creating an instance of a set of
+ * timings. For each phase it holds the total time, the latencies of the
+ * operations timed one at a time and of the batches of operations timed
+ * together, and the number of operations in those batches.
+ */
+struct timingrec {
+    double seconds[NUM_PHASES];
+    struct timing_hist ops[NUM_PHASES];
+    struct timing_hist batches[NUM_PHASES];
+    long batch_ops[NUM_PHASES];
+};
+
+
+/**
+ * Creates a new set of timings with nothing timed.
+ *
+ * @return t The timings.
+ */
+timing timing_new(void) {
+    timing t = emalloc(sizeof * t);
+    memset(t, 0, sizeof * t);
+    return t;
+}
+
+
+/**
+ * Adds time spent on a phase which is not timed one operation at a time.
+ *
+ * @param t The timings.
+ * @param p The phase.
+ * @param seconds The time spent.
+ */
+void timing_add(timing t, phase_t p, double seconds) {
+    t->seconds[p] += seconds;
+}
+
+
+/**
+ * Finds the bucket of the histogram a latency falls into. Latencies under
+ * 4 ns have a bucket each, and each power of two above that is split into
+ * four buckets by the two bits below its top bit.
+ *
+ * @param ns The latency, in nanoseconds.
+ *
+ * @return The bucket.
+ */
+static int timing_bucket(double ns) {
+    unsigned long v = ns < 4294967295.0 ? (unsigned long)ns : 4294967295UL;
+    int top = 0;
+
+    if (v < 4) {
+        return (int)v;
+    }
+    while ((v >> top) > 1) {
+        top++;
+    }
+    return 4 * (top - 1) + (int)((v >> (top - 2)) & 3);
+}
+
+
+/**
+ * Finds the lowest latency which falls into a bucket of the histogram.
+ *
+ * @param bucket The bucket.
+ *
+ * @return The latency, in nanoseconds.
+ */
+static double timing_bucket_start(int bucket) {
+    double start = 4 + bucket % 4;
+    int top = bucket / 4 + 1;
+
+    if (bucket < 4) {
+        return bucket;
+    }
+    while (top-- > 2) {
+        start *= 2;
+    }
+    return start;
+}
+
+
+/**
+ * Counts a latency in a histogram.
+ *
+ * @param h The histogram.
+ * @param seconds The latency.
+ */
+static void timing_hist_add(struct timing_hist *h, double seconds) {
+    double ns = seconds * 1e9;
+
+    h->count++;
+    h->seconds += seconds;
+    h->bucket[timing_bucket(ns)]++;
+    if (ns > h->max_ns) {
+        h->max_ns = ns;
+    }
+}
+
+
+/**
+ * Adds one histogram to another.
+ *
+ * @param h The histogram to add to.
+ * @param from The histogram to add.
+ */
+static void timing_hist_merge(struct timing_hist *h,
+                              const struct timing_hist *from) {
+    int i;
+
+    h->count += from->count;
+    h->seconds += from->seconds;
+    if (from->max_ns > h->max_ns) {
+        h->max_ns = from->max_ns;
+    }
+    for (i = 0; i < TIMING_BUCKETS; i++) {
+        h->bucket[i] += from->bucket[i];
+    }
+}
+
+
+/**
+ * Adds the time taken by one operation of a phase, counting it in the
+ * histogram.
+ *
+ * @param t The timings.
+ * @param p The phase.
+ * @param seconds The time taken.
+ */
+void timing_op(timing t, phase_t p, double seconds) {
+    t->seconds[p] += seconds;
+    timing_hist_add(&t->ops[p], seconds);
+}
+
+
+/**
+ * Adds the time taken by a batch of operations of a phase done together,
+ * counting the batch in the histogram of batches.
+ *
+ * @param t The timings.
+ * @param p The phase.
+ * @param seconds The time taken by the whole batch.
+ * @param n The number of operations in the batch.
+ */
+void timing_batch(timing t, phase_t p, double seconds, int n) {
+    t->seconds[p] += seconds;
+    t->batch_ops[p] += n;
+    timing_hist_add(&t->batches[p], seconds);
+}
+
+
+/**
+ * Adds one set of timings to another, such as those of each thread to
+ * those of the whole run.
+ *
+ * @param t The timings to add to.
+ * @param from The timings to add.
+ */
+void timing_merge(timing t, timing from) {
+    int p;
+
+    for (p = 0; p < NUM_PHASES; p++) {
+        t->seconds[p] += from->seconds[p];
+        t->batch_ops[p] += from->batch_ops[p];
+        timing_hist_merge(&t->ops[p], &from->ops[p]);
+        timing_hist_merge(&t->batches[p], &from->batches[p]);
+    }
+}
+
+
+/**
+ * Estimates a percentile of the latencies in a histogram, as the end of
+ * the bucket it falls into.
+ *
+ * @param h The histogram.
+ * @param percent The percentile, from 0 to 100.
+ *
+ * @return The latency, in nanoseconds.
+ */
+static double timing_percentile(const struct timing_hist *h, double percent) {
+    double wanted = percent / 100.0 * h->count;
+    long seen = 0;
+    int i;
+
+    for (i = 0; i < TIMING_BUCKETS - 1; i++) {
+        seen += h->bucket[i];
+        if (seen > 0 && seen >= wanted) {
+            break;
+        }
+    }
+    return timing_bucket_start(i + 1) < h->max_ns
+        ? timing_bucket_start(i + 1) : h->max_ns;
+}
+
+
+/**
+ * Writes the mean, percentiles and maximum of the latencies in a histogram
+ * as JSON members, followed by the histogram as pairs of where each bucket
+ * starts and how many latencies it holds.
+ *
+ * @param h The histogram, which must hold at least one latency.
+ * @param prefix What the name of each member starts with.
+ * @param out The stream to write to.
+ */
+static void timing_write_hist(const struct timing_hist *h, const char *prefix,
+                              FILE *out) {
+    int i, first = 1;
+
+    fprintf(out, ", \"%sns_mean\": %.1f, \"%sns_p50\": %.0f, "
+            "\"%sns_p90\": %.0f, \"%sns_p99\": %.0f, ",
+            prefix, h->seconds * 1e9 / h->count,
+            prefix, timing_percentile(h, 50), prefix, timing_percentile(h, 90),
+            prefix, timing_percentile(h, 99));
+    fprintf(out, "\"%sns_p999\": %.0f, \"%sns_max\": %.0f,\n"
+            "      \"%shistogram\": [",
+            prefix, timing_percentile(h, 99.9), prefix, h->max_ns, prefix);
+    for (i = 0; i < TIMING_BUCKETS; i++) {
+        if (h->bucket[i] > 0) {
+            fprintf(out, "%s[%.0f, %ld]", first ? "" : ", ",
+                    timing_bucket_start(i), h->bucket[i]);
+            first = 0;
+        }
+    }
+    fprintf(out, "]");
+}
+
+
+/**
+ * Writes the timings as a JSON object with a member for each phase, which
+ * holds its total time and number of operations. Phases with operations
+ * timed one at a time also have the latencies of those operations, and
+ * phases with operations done in batches have the number of batches and
+ * the latencies of whole batches, under names starting with batch_.
+ *
+ * @param t The timings.
+ * @param out The stream to write to.
+ */
+void timing_write_json(timing t, FILE *out) {
+    int p;
+
+    fprintf(out, "{");
+    for (p = 0; p < NUM_PHASES; p++) {
+        fprintf(out, "%s\n    \"%s\": {\"seconds\": %.9f, \"ops\": %ld",
+                p > 0 ? "," : "", phase_names[p], t->seconds[p],
+                t->ops[p].count + t->batch_ops[p]);
+        if (t->ops[p].count > 0) {
+            timing_write_hist(&t->ops[p], "", out);
+        }
+        if (t->batches[p].count > 0) {
+            fprintf(out, ",\n      \"batches\": %ld", t->batches[p].count);
+            timing_write_hist(&t->batches[p], "batch_", out);
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n  }");
+}
+
+
+/**
+ * Frees the memory allocated to a set of timings.
+ *
+ * @param t The timings.
+ */
+void timing_free(timing t) {
+    free(t);
+}
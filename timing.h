@@ -0,0 +1,24 @@
+/**
+ * Header file for per-phase timing implementation.
+ *
+ */
+#ifndef TIMING_H_
+#define TIMING_H_
+
+#include <stdio.h>
+
+typedef struct timingrec *timing;
+typedef enum phase_e {
+    READ_PHASE, INSERT_PHASE, LOOKUP_PHASE, OUTPUT_PHASE, FREE_PHASE,
+    NUM_PHASES
+} phase_t;
+
+extern timing timing_new(void);
+extern void   timing_add(timing t, phase_t p, double seconds);
+extern void   timing_op(timing t, phase_t p, double seconds);
+extern void   timing_batch(timing t, phase_t p, double seconds, int n);
+extern void   timing_merge(timing t, timing from);
+extern void   timing_write_json(timing t, FILE *out);
+extern void   timing_free(timing t);
+
+#endif
@@ -1,5 +1,7 @@
 /**
- * A modular implementation of a binary tree data structure.
+ * A modular implementation of a binary tree data structure. Everything
+ * about a tree, down to its type, is kept in its own handle, so any
+ * number of trees of either type can be held at once.
  * 13/09/18.
  * @author Kelson Sadlier
  * @author Quinn Thorsnes
@@ -8,10 +10,16 @@
  */
 #include <stdlib.h>
 #include "tree.h"
+#include "arena.h"
+#include "image.h"
 #include "mylib.h"
 #include <string.h>
 #include <stdio.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 
 /**
  * Macros for checking the 'colour' field of a rbt node.
@@ -23,26 +31,86 @@
 
 
 typedef enum { RED, BLACK } tree_colour;
+typedef struct tree_node *subtree;
 
 
 /**
- * Data field to hold the type of binary tree being used. Either an rbt or bst.
- */
-static tree_t tree_type;
-
-
-/**
- * tree_node struct is the blueprint for creating an instance of a binary tree.
+ * tree_node struct is the blueprint for creating a node of a binary tree.
  */
 struct tree_node {
     char *key;
-    tree left;
-    tree right;
+    subtree left;
+    subtree right;
     int frequency;
     tree_colour colour;
 };
 
 
+/**
+ * tree_step struct is one entry of the stack used to walk a tree without
+ * recursion, holding a node and the link in its parent which points to it.
+ */
+struct tree_step {
+    subtree node;
+    subtree *link;
+};
+
+
+/**
+ * tree_flat struct holds a frozen copy of a tree. The first four bytes of
+ * each key are taken as a number which sorts the same way as the key, and
+ * each different prefix is kept once, laid out in Eytzinger order: the
+ * root is at 1 and the children of i at 2i and 2i + 1, so searching it is
+ * a walk down an array with no pointers to follow. The keys with the
+ * prefix at i are key[first[i]] up to but not including key[last[i]].
+ * The keys are kept in sorted order, copied into an arena of their own.
+ */
+struct tree_flat {
+    int num_prefixes;
+    unsigned int *prefix;
+    int *first;
+    int *last;
+    char **key;
+    arena keys;
+};
+
+
+/**
+ * treerec struct is the handle for a binary tree. It holds:
+ * the type of tree, either an rbt or bst;
+ * the root node;
+ * the arena which the nodes and keys of the tree are allocated from, so
+ * they are packed together and can all be freed at once;
+ * the mapping of the image the tree was loaded from, if it was, which
+ * holds its original nodes and keys;
+ * the path from the root to the last node inserted into an rbt, kept
+ * between insertions so that it only has to be allocated once;
+ * and the frozen copy of the tree made by tree_freeze, if there is one.
+ */
+struct treerec {
+    tree_t type;
+    subtree root;
+    arena store;
+    char *map;
+    size_t map_len;
+    struct tree_step *path;
+    int path_cap;
+    struct tree_flat *flat;
+};
+
+
+/**
+ * tree_image struct heads an image of a tree. It is followed by the nodes
+ * in preorder, and then their keys.
+ */
+struct tree_image {
+    struct image_header header;
+    tree_t type;
+    int num_nodes;
+    subtree root;
+};
+
+
 /**
  * Creates a new tree of the specified type.
  *
@@ -53,8 +121,16 @@ struct tree_node {
  * @return tree A new tree
  */
 tree tree_new(tree_t type) {
-    tree_type = type;
-    return NULL;
+    tree T = emalloc(sizeof * T);
+    T->type = type;
+    T->root = NULL;
+    T->store = arena_new();
+    T->map = NULL;
+    T->map_len = 0;
+    T->path = NULL;
+    T->path_cap = 0;
+    T->flat = NULL;
+    return T;
 }
 
 
@@ -65,8 +141,8 @@ tree tree_new(tree_t type) {
  *
  * @return T The updated rbt.
  */
-static tree right_rotate(tree T) {
-    tree temp = T;
+static subtree right_rotate(subtree T) {
+    subtree temp = T;
     T = T->left;
     temp->left = T->right;
     T->right = temp;
@@ -81,8 +157,8 @@ static tree right_rotate(tree T) {
  *
  * @return T The updated rbt.
  */
-static tree left_rotate(tree T) {
-    tree temp = T;
+static subtree left_rotate(subtree T) {
+    subtree temp = T;
     T = T->right;
     temp->right = T->left;
     T->left = temp;
@@ -99,7 +175,7 @@ static tree left_rotate(tree T) {
  *
  * @return T the updated node in the rbt.
  */
-static tree tree_fix(tree T) {
+static subtree tree_fix(subtree T) {
     if (IS_RED(T->left) && IS_RED(T->left->left)) {
         if (IS_RED(T->right)) {
             T->colour = RED;
@@ -147,44 +223,258 @@ static tree tree_fix(tree T) {
 }
 
 
+/**
+ * Pushes a node onto a stack used to walk a tree, growing the stack if it
+ * is full. Empty subtrees are not pushed.
+ *
+ * @param stack The stack.
+ * @param size The number of steps on the stack, which is increased.
+ * @param cap The number of steps the stack has room for.
+ * @param node The node.
+ * @param link The link pointing to the node.
+ *
+ * @return The stack, which may have moved.
+ */
+static struct tree_step *tree_push(struct tree_step *stack, int *size,
+                                   int *cap, subtree node, subtree *link) {
+    if (node == NULL) {
+        return stack;
+    }
+    if (*size == *cap) {
+        *cap = *cap > 0 ? 2 * *cap : 64;
+        stack = erealloc(stack, *cap * sizeof stack[0]);
+    }
+    stack[*size].node = node;
+    stack[*size].link = link;
+    (*size)++;
+    return stack;
+}
+
+
+/**
+ * Compares the key of a node with a word which may not be '\0' terminated,
+ * in the same order as strcmp.
+ *
+ * @param node_key The key stored in the node.
+ * @param key The word.
+ * @param len The length of the word.
+ *
+ * @return Less than, equal to or greater than 0 if node_key comes before,
+ * is the same as or comes after the word.
+ */
+static int tree_compare(const char *node_key, const char *key, int len) {
+    int cmp = strncmp(node_key, key, len);
+    return cmp != 0 ? cmp : node_key[len] != '\0';
+}
+
+
+/**
+ * Drops the frozen copy of the tree, if there is one.
+ *
+ * @param T The tree.
+ */
+static void tree_thaw(tree T) {
+    if (T->flat != NULL) {
+        arena_free(T->flat->keys);
+        free(T->flat->prefix);
+        free(T->flat->first);
+        free(T->flat->last);
+        free(T->flat->key);
+        free(T->flat);
+        T->flat = NULL;
+    }
+}
+
+
 /**
  * Inserts a string into the data structure by creating and allocating a new
- * node and copying the string into its key data field. If the tree is a rbt
- * then tree_fix is called to ensure the tree complies with an rbt.
+ * node and copying the string into its key data field, counting it a number
+ * of times. If the tree is a rbt then tree_fix is called on every node from
+ * there back up to the root to ensure the tree complies with an rbt. The
+ * tree is walked down without recursion, comparing the string once at each
+ * node, so a bst built from sorted words can be as deep as it likes.
  *
  * @param T The tree we are inserting a word into.
- * @param key The string we wish to place in the tree.
+ * @param key The string we wish to place in the tree, which need not be
+ * '\0' terminated.
+ * @param len The length of the string.
+ * @param count The number of times to count the string.
  *
  * @return T the newly updated tree.
  */
-tree tree_insert(tree T, char *key) {
-    if (T == NULL) {
-        T = emalloc(sizeof * T);
-        T->left = NULL;
-        T->right = NULL;
-        T->frequency = 1;
-        T->key = emalloc((strlen(key) + 1) * sizeof(T->key));
-        strcpy(T->key, key);
-        if (tree_type == RBT) {
-            T->colour = RED;
+tree tree_insert_count(tree T, const char *key, int len, int count) {
+    subtree *link = &T->root;
+    subtree node;
+    int depth = 0, cmp = 1;
+
+    tree_thaw(T);
+    while ((node = *link) != NULL) {
+        if (T->type == RBT) {
+            T->path = tree_push(T->path, &depth, &T->path_cap, node, link);
+        }
+        cmp = tree_compare(node->key, key, len);
+        if (cmp == 0) {
+            break;
         }
-    } else if (strcmp(T->key, key) < 0) {
-        T->right = tree_insert(T->right, key);
-    } else if (strcmp(T->key, key) > 0) {
-        T->left = tree_insert(T->left, key);
+        link = cmp < 0 ? &node->right : &node->left;
+    }
+    if (cmp == 0) {
+        node->frequency += count;
     } else {
-        T->frequency++;
+        node = arena_alloc(T->store, sizeof * node);
+        node->left = NULL;
+        node->right = NULL;
+        node->frequency = count;
+        node->key = arena_strndup(T->store, key, len);
+        node->colour = RED;
+        *link = node;
+        if (T->type == RBT) {
+            T->path = tree_push(T->path, &depth, &T->path_cap, node, link);
+        }
+    }
+    while (depth > 0) {
+        depth--;
+        *T->path[depth].link = tree_fix(T->path[depth].node);
     }
-    if (tree_type == RBT) {
-        T = tree_fix(T);
-     }
     return T;
 }
 
 
 /**
- * Searches the specified tree for a given value.
- * Returns 1 if the value was found, 0 if not.
+ * Inserts a string into the data structure.
+ *
+ * @param T The tree we are inserting a word into.
+ * @param key The string we wish to place in the tree, which need not be
+ * '\0' terminated.
+ * @param len The length of the string.
+ *
+ * @return T the newly updated tree.
+ */
+tree tree_insert_n(tree T, const char *key, int len) {
+    return tree_insert_count(T, key, len, 1);
+}
+
+
+/**
+ * Inserts a '\0' terminated string into the data structure.
+ *
+ * @param T The tree we are inserting a word into.
+ * @param key The string we wish to place in the tree.
+ *
+ * @return T the newly updated tree.
+ */
+tree tree_insert(tree T, char *key) {
+    return tree_insert_n(T, key, strlen(key));
+}
+
+
+/**
+ * Works out the first four bytes of a word as a number, padded with 0s,
+ * which compares with those of other words the same way strcmp would.
+ *
+ * @param key The word, which need not be '\0' terminated.
+ * @param len The length of the word.
+ *
+ * @return The prefix.
+ */
+static unsigned int tree_prefix(const char *key, int len) {
+    unsigned int p = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        p = (p << 8) | (i < len ? (unsigned char)key[i] : 0);
+    }
+    return p;
+}
+
+
+/**
+ * Searches the frozen copy of the tree. Each step down the prefixes picks
+ * the child to go to from whether its prefix comes before the words,
+ * adding the result of the comparison to the index rather than branching
+ * on it, and fetches the prefixes four levels further down ahead of time,
+ * since the 16 descendants there lie side by side. Once the walk falls off
+ * the bottom, the right shifts that undo its last run of steps to the
+ * right give the first prefix not before the words. If it is the words
+ * prefix, the keys sharing it are then searched by comparing strings.
+ *
+ * @param flat The frozen copy.
+ * @param key The string to search for, which need not be '\0' terminated.
+ * @param len The length of the string.
+ *
+ * @return int 1 if the string was found and 0 if not.
+ */
+static int tree_flat_search(const struct tree_flat *flat, const char *key,
+                            int len) {
+    const unsigned int *prefix = flat->prefix;
+    unsigned int p = tree_prefix(key, len);
+    int n = flat->num_prefixes, i = 1, low, high, mid, cmp;
+
+    while (i <= n) {
+#ifdef __SSE2__
+        _mm_prefetch((const char *)(prefix + 16 * i), _MM_HINT_T0);
+#endif
+        i = 2 * i + (prefix[i] < p);
+    }
+    while (i & 1) {
+        i >>= 1;
+    }
+    i >>= 1;
+    if (i == 0 || prefix[i] != p) {
+        return 0;
+    }
+    low = flat->first[i];
+    high = flat->last[i];
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        cmp = tree_compare(flat->key[mid], key, len);
+        if (cmp == 0) {
+            return 1;
+        }
+        if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Searches the specified tree for a given value, comparing it once with
+ * each node on the way down, or searches its frozen copy if it has one.
+ * Returns 1 if the value was found, 0 if not. Searching does not change
+ * the tree, so any number of threads can search it at once as long as
+ * none of them is inserting into it.
+ *
+ * @param T The tree to search.
+ * @param key The string to search for, which need not be '\0' terminated.
+ * @param len The length of the string.
+ *
+ * @return int 1 if the string was found and 0 if not.
+ */
+int tree_search_n(tree T, const char *key, int len) {
+    subtree node = T->root;
+    int cmp;
+
+    if (T->flat != NULL) {
+        return tree_flat_search(T->flat, key, len);
+    }
+    while (node != NULL) {
+        cmp = tree_compare(node->key, key, len);
+        if (cmp == 0) { /* key found */
+            return 1;
+        }
+        /* key comes before or after */
+        node = cmp > 0 ? node->left : node->right;
+    }
+    return 0; /* key not found */
+}
+
+
+/**
+ * Searches the specified tree for a given '\0' terminated value.
  *
  * @param T The tree to search.
  * @param key The string to search for.
@@ -192,32 +482,115 @@ tree tree_insert(tree T, char *key) {
  * @return int 1 if the string was found and 0 if not.
  */
 int tree_search(tree T, char *key) {
-    if (T == NULL) { /* key not found */
-        return 0; 
-    } else if (strcmp(T->key, key) == 0) { /* key found */
-        return 1; 
-    } else if (strcmp(T->key, key) > 0) { /* key comes before current */
-        return tree_search(T->left, key);
-    } else  if (strcmp(T->key, key) < 0) { /* key comes after current */
-        return tree_search(T->right, key);
+    return tree_search_n(T, key, strlen(key));
+}
+
+
+/**
+ * Fills in the prefixes of the frozen copy of a tree, by walking the
+ * implicit tree in order and handing out the different prefixes of the
+ * sorted keys as it goes.
+ *
+ * @param flat The frozen copy, whose keys are in place.
+ * @param next The index of the first key with the next prefix to hand out,
+ * which is moved on past the keys with that prefix.
+ * @param i The index of the node to fill in.
+ */
+static void tree_flat_fill(struct tree_flat *flat, int *next, int i) {
+    if (i > flat->num_prefixes) {
+        return;
+    }
+    tree_flat_fill(flat, next, 2 * i);
+    flat->first[i] = *next;
+    flat->prefix[i] = tree_prefix(flat->key[*next],
+                                  strlen(flat->key[*next]));
+    do {
+        (*next)++;
+    } while (flat->key[*next] != NULL
+             && tree_prefix(flat->key[*next], strlen(flat->key[*next]))
+             == flat->prefix[i]);
+    flat->last[i] = *next;
+    tree_flat_fill(flat, next, 2 * i + 1);
+}
+
+
+/**
+ * Freezes the tree into a copy laid out in Eytzinger order, for when no
+ * more words will be added. Searches of the tree then use the copy. The
+ * tree itself is kept as it was, so it can still be printed or saved, and
+ * the copy is dropped again if a word is inserted.
+ *
+ * @param T The tree.
+ */
+void tree_freeze(tree T) {
+    struct tree_step *stack = NULL;
+    struct tree_flat *flat;
+    int size = 0, cap = 0, n = 0, sorted_cap = 0, next = 0, i;
+    char **sorted = NULL;
+    unsigned int p, last = 0;
+    subtree node = T->root;
+
+    tree_thaw(T);
+    while (node != NULL || size > 0) {
+        while (node != NULL) {
+            stack = tree_push(stack, &size, &cap, node, NULL);
+            node = node->left;
+        }
+        node = stack[--size].node;
+        if (n == sorted_cap) {
+            sorted_cap = sorted_cap > 0 ? 2 * sorted_cap : 64;
+            sorted = erealloc(sorted, sorted_cap * sizeof sorted[0]);
+        }
+        sorted[n++] = node->key;
+        node = node->right;
+    }
+    free(stack);
+
+    flat = emalloc(sizeof * flat);
+    flat->num_prefixes = 0;
+    flat->key = emalloc((n + 1) * sizeof flat->key[0]);
+    flat->keys = arena_new();
+    for (i = 0; i < n; i++) {
+        flat->key[i] = arena_strndup(flat->keys, sorted[i],
+                                     strlen(sorted[i]));
+        p = tree_prefix(sorted[i], strlen(sorted[i]));
+        if (i == 0 || p != last) {
+            flat->num_prefixes++;
+        }
+        last = p;
     }
-    return 1;
+    flat->key[n] = NULL;
+    flat->prefix = emalloc((flat->num_prefixes + 1) * sizeof flat->prefix[0]);
+    flat->first = emalloc((flat->num_prefixes + 1) * sizeof flat->first[0]);
+    flat->last = emalloc((flat->num_prefixes + 1) * sizeof flat->last[0]);
+    tree_flat_fill(flat, &next, 1);
+    flat->prefix[0] = 0;
+    flat->first[0] = flat->last[0] = 0;
+    free(sorted);
+    T->flat = flat;
 }
 
 
 /**
- * Executes a function on each node of the tree in prefix order.
+ * Executes a function on each node of the tree in prefix order, keeping
+ * the nodes still to visit on a stack rather than recursing.
  *
  * @param T The tree on which to execute the function.
  * @param f(char *key) The function to be executed.
  */
 void tree_preorder(tree T, void f(int freq, char *key)) {
-    if(T == NULL) {
-        return;
+    struct tree_step *stack = NULL;
+    int size = 0, cap = 0;
+    subtree node;
+
+    stack = tree_push(stack, &size, &cap, T->root, NULL);
+    while (size > 0) {
+        node = stack[--size].node;
+        f(node->frequency, node->key);
+        stack = tree_push(stack, &size, &cap, node->right, NULL);
+        stack = tree_push(stack, &size, &cap, node->left, NULL);
     }
-    f(T->frequency, T->key);
-    tree_preorder(T->left, f);
-    tree_preorder(T->right, f);
+    free(stack);
 }
 
 
@@ -229,54 +602,202 @@ void tree_preorder(tree T, void f(int freq, char *key)) {
  * @return the updated tree.
  */
 tree tree_fix_root(tree T) {
-    if(IS_RED(T)) {
-        T->colour = BLACK;
+    if(IS_RED(T->root)) {
+        T->root->colour = BLACK;
     }
     return T;
 }
 
 
 /**
- * Frees all memory assosiated with a particular binary tree but recursively
- * decending through the data structure similar to a post-order-traversal.
+ * Frees all memory assosiated with the binary tree. Every node and key was
+ * allocated from the trees arena, or lies in the image it was loaded from,
+ * so this takes one free per arena chunk rather than a walk over the whole
+ * tree.
  *
  * @param T the tree we wish to deallocate memory for.
  *
  * @return a pointer to our now empty tree.
  */
 tree tree_free(tree T) {
-    if (T == NULL) {
-        return T;
+    arena_free(T->store);
+    if (T->map != NULL) {
+        image_unmap(T->map, T->map_len);
     }
-    tree_free(T->left);
-    tree_free(T->right);
-    free(T->key);
+    tree_thaw(T);
+    free(T->path);
     free(T);
+    T = NULL;
     return T;
 }
 
 
 /**
- * Traverses the tree writing a DOT description about connections, and
- * possibly colours, to the given output stream.
+ * Counts the nodes of a tree and the space taken by their keys.
  *
- * @param t the tree to output a DOT description of.
- * @param out the stream to write the DOT output to.
+ * @param T The tree.
+ * @param nodes Increased by the number of nodes.
+ * @param bytes Increased by the size of the keys, including their '\0's.
  */
-static void tree_output_dot_aux(tree t, FILE *out) {
-    if(t->key != NULL) {
-        fprintf(out, "\"%s\"[label=\"{<f0>%s:%d|{<f1>|<f2>}}\"color=%s];\n",
-                t->key, t->key, t->frequency,
-                (RBT == tree_type && RED == t->colour) ? "red":"black");
+static void tree_measure(subtree T, int *nodes, size_t *bytes) {
+    struct tree_step *stack = NULL;
+    int size = 0, cap = 0;
+
+    stack = tree_push(stack, &size, &cap, T, NULL);
+    while (size > 0) {
+        T = stack[--size].node;
+        (*nodes)++;
+        *bytes += strlen(T->key) + 1;
+        stack = tree_push(stack, &size, &cap, T->right, NULL);
+        stack = tree_push(stack, &size, &cap, T->left, NULL);
     }
-    if(t->left != NULL) {
-        tree_output_dot_aux(t->left, out);
-        fprintf(out, "\"%s\":f1 -> \"%s\":f0;\n", t->key, t->left->key);
+    free(stack);
+}
+
+
+/**
+ * Copies a tree into an image in preorder, so that a search walks forward
+ * through the image from the root. Each copy is linked into its parent's
+ * copy as it is made.
+ *
+ * @param T The root of the tree.
+ * @param image The image.
+ * @param node The offset to copy the next node to, which is moved on.
+ * @param key The offset to copy the next key to, which is moved on.
+ *
+ * @return The copy of T as it will be addressed once the image is mapped.
+ */
+static subtree tree_copy_to_image(subtree T, char *image, size_t *node,
+                                  size_t *key) {
+    struct tree_step *stack = NULL;
+    int size = 0, cap = 0;
+    subtree root = NULL, copy;
+
+    stack = tree_push(stack, &size, &cap, T, &root);
+    while (size > 0) {
+        size--;
+        T = stack[size].node;
+        copy = (subtree)(image + *node);
+        *stack[size].link = IMAGE_AT(*node);
+        *node += sizeof * copy;
+        *copy = *T;
+        strcpy(image + *key, T->key);
+        copy->key = IMAGE_AT(*key);
+        *key += strlen(T->key) + 1;
+        copy->left = NULL;
+        copy->right = NULL;
+        stack = tree_push(stack, &size, &cap, T->right, &copy->right);
+        stack = tree_push(stack, &size, &cap, T->left, &copy->left);
     }
-    if(t->right != NULL) {
-        tree_output_dot_aux(t->right, out);
-        fprintf(out, "\"%s\":f2 -> \"%s\":f0;\n", t->key, t->right->key);
+    free(stack);
+    return root;
+}
+
+
+/**
+ * Saves the tree to an image file which tree_load can map back in.
+ *
+ * @param T The tree.
+ * @param filename The file to write.
+ */
+void tree_save(tree T, const char *filename) {
+    struct tree_image *im;
+    char *image;
+    size_t size, node, key = 0;
+    int nodes = 0;
+
+    tree_measure(T->root, &nodes, &key);
+    node = IMAGE_ALIGN(sizeof * im);
+    size = node + nodes * sizeof * T->root + key;
+    key = node + nodes * sizeof * T->root;
+    image = emalloc(size);
+    memset(image, 0, size);
+
+    im = (struct tree_image *)image;
+    im->type = T->type;
+    im->num_nodes = nodes;
+    im->root = tree_copy_to_image(T->root, image, &node, &key);
+    image_write(filename, 'T', image, size);
+    free(image);
+}
+
+
+/**
+ * Loads a tree from an image file written by tree_save. The image is
+ * mapped and used in place, so nothing is inserted or compared, and the
+ * type of tree is taken from the image. Words can still be added to the
+ * loaded tree.
+ *
+ * @param filename The file to load.
+ *
+ * @return The tree.
+ */
+tree tree_load(const char *filename) {
+    struct tree_image *im;
+    subtree nodes;
+    size_t map_len;
+    char *map = image_map(filename, 'T', &map_len);
+    tree T;
+    int i;
+
+    im = (struct tree_image *)map;
+    T = tree_new(im->type);
+    T->map = map;
+    T->map_len = map_len;
+    if (image_moved(map)) {
+        nodes = (subtree)(map + IMAGE_ALIGN(sizeof * im));
+        for (i = 0; i < im->num_nodes; i++) {
+            nodes[i].key = image_relocate(map, nodes[i].key);
+            nodes[i].left = image_relocate(map, nodes[i].left);
+            nodes[i].right = image_relocate(map, nodes[i].right);
+        }
+        im->root = image_relocate(map, im->root);
+    }
+    T->root = im->root;
+    return T;
+}
+
+
+/**
+ * Traverses the tree writing a DOT description about connections, and
+ * possibly colours, to the given output stream. The tree is walked with a
+ * stack rather than recursion, so a degenerate tree can't overflow the
+ * call stack. The link from a node to a child is pushed beneath the child,
+ * so it is written once the child's subtree has been.
+ *
+ * @param t the root of the tree to output a DOT description of.
+ * @param type the type of the tree.
+ * @param out the stream to write the DOT output to.
+ */
+static void tree_output_dot_aux(subtree t, tree_t type, FILE *out) {
+    struct tree_step *stack = NULL;
+    struct tree_step step;
+    int size = 0, cap = 0;
+
+    stack = tree_push(stack, &size, &cap, t, NULL);
+    while (size > 0) {
+        step = stack[--size];
+        t = step.node;
+        if (step.link != NULL) {
+            fprintf(out, "\"%s\":%s -> \"%s\":f0;\n", t->key,
+                    step.link == &t->left ? "f1" : "f2", (*step.link)->key);
+            continue;
+        }
+        if(t->key != NULL) {
+            fprintf(out, "\"%s\"[label=\"{<f0>%s:%d|{<f1>|<f2>}}\"color=%s];\n",
+                    t->key, t->key, t->frequency,
+                    (RBT == type && RED == t->colour) ? "red":"black");
+        }
+        if(t->right != NULL) {
+            stack = tree_push(stack, &size, &cap, t, &t->right);
+            stack = tree_push(stack, &size, &cap, t->right, NULL);
+        }
+        if(t->left != NULL) {
+            stack = tree_push(stack, &size, &cap, t, &t->left);
+            stack = tree_push(stack, &size, &cap, t->left, NULL);
+        }
     }
+    free(stack);
 }
 
 
@@ -294,6 +815,8 @@ static void tree_output_dot_aux(tree t, FILE *out) {
  */
 void tree_output_dot(tree t, FILE *out) {
    fprintf(out, "digraph tree {\nnode [shape = Mrecord, penwidth = 2];\n");
-   tree_output_dot_aux(t, out);
+   if (t->root != NULL) {
+       tree_output_dot_aux(t->root, t->type, out);
+   }
    fprintf(out, "}\n");
 }
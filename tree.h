@@ -12,14 +12,21 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-typedef struct tree_node *tree;
+typedef struct treerec *tree;
 typedef enum tree_e {BST, RBT} tree_t;
 
-extern tree     tree_new();
+extern tree     tree_new(tree_t type);
 extern tree     tree_insert(tree T, char *key);
+extern tree     tree_insert_n(tree T, const char *key, int len);
+extern tree     tree_insert_count(tree T, const char *key, int len,
+                                  int count);
 extern int      tree_search(tree T, char *key);
+extern int      tree_search_n(tree T, const char *key, int len);
 extern void     tree_preorder(tree T, void f(int frequency, char *key));
 extern tree     tree_free(tree T);
+extern void     tree_freeze(tree T);
+extern tree     tree_load(const char *filename);
+extern void     tree_save(tree T, const char *filename);
 extern tree     tree_fix_root(tree T);
 extern void     tree_print(char *key);
 extern void     tree_output_dot(tree t, FILE *out);
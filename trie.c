@@ -0,0 +1,549 @@
+/**
+ * A path compressed radix trie, holding words and their frequencies with the
+ * same interface as the binary tree. Words which share a prefix share the
+ * nodes along it, and a run of nodes with only one child is merged into a
+ * single node holding the whole run as its prefix, so a lookup takes one
+ * step per branch in the word rather than a string compare per level.
+ *
+ * As in an adaptive radix tree, each node is only as big as it needs to
+ * be. A node starts as a leaf with no room for children, and is replaced
+ * by a node with room for 4, then 8, 16, 48 and 256 children as it fills
+ * up.
+ * The prefix is kept in the same allocation, straight after the node.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "trie.h"
+#include "arena.h"
+#include "mylib.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+/**
+ * The kinds of node, by how many children they have room for.
+ */
+typedef enum { LEAF, NODE4, NODE8, NODE16, NODE48, NODE256 } trie_kind;
+
+
+/**
+ * Macro for finding the prefix of a node, which follows the node itself.
+ *
+ * @param x The given node.
+ */
+#define TRIE_PREFIX(x) ((char *)(x) + trie_sizes[(x)->kind])
+
+
+typedef struct trie_node *subtrie;
+
+
+/**
+ * trie_node struct starts every node of a trie. freq is the number of
+ * times the word ending at the node was counted, or 0 if no word ends
+ * there. The node stands for the word of its parent, then the byte its
+ * parent knows it by, then its prefix.
+ */
+struct trie_node {
+    int freq;
+    int prefix_len;
+    unsigned char kind;
+    unsigned short num_children;
+};
+
+
+/**
+ * trierec struct is the handle for a trie. It holds the root node and the
+ * arena which the nodes of the trie are allocated from. A node which grows
+ * is copied into a bigger one, and the old one is kept in spare to be
+ * reused for the next new node of its kind, linked to the next spare node
+ * by its first child. Leaves have no room for the link, so they are left
+ * in the arena until the whole trie is freed.
+ */
+struct trierec {
+    subtrie root;
+    arena store;
+    subtrie spare[NODE256];
+};
+
+
+/**
+ * Nodes with room for 4, 8 or 16 children keep the bytes of their children
+ * in order, with each child beside its byte. Nodes with room for 48 have an
+ * index by byte of where each child is kept, counting from 1 so that 0
+ * means no child, and nodes with room for 256 keep each child at its byte.
+ */
+struct trie_node4 {
+    struct trie_node n;
+    unsigned char keys[4];
+    subtrie child[4];
+};
+
+struct trie_node8 {
+    struct trie_node n;
+    unsigned char keys[8];
+    subtrie child[8];
+};
+
+struct trie_node16 {
+    struct trie_node n;
+    unsigned char keys[16];
+    subtrie child[16];
+};
+
+struct trie_node48 {
+    struct trie_node n;
+    unsigned char index[256];
+    subtrie child[48];
+};
+
+struct trie_node256 {
+    struct trie_node n;
+    subtrie child[256];
+};
+
+
+/**
+ * The size of each kind of node, and how many children it has room for.
+ */
+static const size_t trie_sizes[] = {
+    sizeof(struct trie_node), sizeof(struct trie_node4),
+    sizeof(struct trie_node8), sizeof(struct trie_node16),
+    sizeof(struct trie_node48), sizeof(struct trie_node256)
+};
+static const int trie_capacity[] = { 0, 4, 8, 16, 48, 256 };
+
+
+/**
+ * Creates a new empty trie.
+ *
+ * @return A new trie.
+ */
+trie trie_new(void) {
+    trie T = emalloc(sizeof * T);
+    int i;
+
+    T->root = NULL;
+    T->store = arena_new();
+    for (i = 0; i < NODE256; i++) {
+        T->spare[i] = NULL;
+    }
+    return T;
+}
+
+
+/**
+ * Finds the bytes and children of a node with room for 4, 8 or 16
+ * children.
+ *
+ * @param n The node.
+ * @param keys Set to the bytes of the children.
+ * @param child Set to the children.
+ */
+static void trie_slots(subtrie n, unsigned char **keys, subtrie **child) {
+    if (n->kind == NODE4) {
+        *keys = ((struct trie_node4 *)n)->keys;
+        *child = ((struct trie_node4 *)n)->child;
+    } else if (n->kind == NODE8) {
+        *keys = ((struct trie_node8 *)n)->keys;
+        *child = ((struct trie_node8 *)n)->child;
+    } else {
+        *keys = ((struct trie_node16 *)n)->keys;
+        *child = ((struct trie_node16 *)n)->child;
+    }
+}
+
+
+/**
+ * Finds the first child of a node with room for 4 to 48 children,
+ * which links it to the next spare node once it has been grown out of.
+ *
+ * @param n The node.
+ *
+ * @return Where the node keeps its first child.
+ */
+static subtrie *trie_link(subtrie n) {
+    unsigned char *keys;
+    subtrie *child;
+
+    if (n->kind == NODE48) {
+        return ((struct trie_node48 *)n)->child;
+    }
+    trie_slots(n, &keys, &child);
+    return child;
+}
+
+
+/**
+ * Allocates a node with no children.
+ *
+ * @param T The trie the node belongs to.
+ * @param kind The size of node.
+ * @param prefix The prefix of the node.
+ * @param prefix_len The length of the prefix.
+ *
+ * @return The node.
+ */
+static subtrie trie_node_new(trie T, trie_kind kind, const char *prefix,
+                             int prefix_len) {
+    subtrie n = kind < NODE256 ? T->spare[kind] : NULL;
+
+    if (n != NULL && n->prefix_len >= prefix_len) {
+        T->spare[kind] = *trie_link(n);
+    } else {
+        n = arena_alloc(T->store, trie_sizes[kind] + prefix_len);
+    }
+    memset(n, 0, trie_sizes[kind]);
+    n->kind = kind;
+    n->prefix_len = prefix_len;
+    memcpy(TRIE_PREFIX(n), prefix, prefix_len);
+    return n;
+}
+
+
+/**
+ * Finds the child of a node for a given byte.
+ *
+ * @param n The node.
+ * @param c The byte.
+ *
+ * @return Where the node keeps the child, or NULL if it has none for c.
+ */
+static subtrie *trie_find_child(subtrie n, unsigned char c) {
+    unsigned char *keys;
+    subtrie *child;
+    int i;
+#ifdef __SSE2__
+    unsigned int match;
+#endif
+
+    if (n->kind == NODE256) {
+        child = &((struct trie_node256 *)n)->child[c];
+        return *child != NULL ? child : NULL;
+    } else if (n->kind == NODE48) {
+        i = ((struct trie_node48 *)n)->index[c];
+        return i != 0 ? &((struct trie_node48 *)n)->child[i - 1] : NULL;
+    } else if (n->kind == LEAF) {
+        return NULL;
+    }
+    trie_slots(n, &keys, &child);
+#ifdef __SSE2__
+    if (n->kind == NODE16) {
+        match = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)keys),
+                           _mm_set1_epi8((char)c)));
+        match &= (1U << n->num_children) - 1;
+        return match != 0 ? &child[__builtin_ctz(match)] : NULL;
+    }
+#endif
+    for (i = 0; i < n->num_children; i++) {
+        if (keys[i] == c) {
+            return &child[i];
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Copies a full node into a node with room for more children.
+ *
+ * @param T The trie the node belongs to.
+ * @param n The node.
+ *
+ * @return The bigger node.
+ */
+static subtrie trie_grow(trie T, subtrie n) {
+    subtrie big = trie_node_new(T, n->kind + 1, TRIE_PREFIX(n),
+                                n->prefix_len);
+    struct trie_node48 *n48 = (struct trie_node48 *)n;
+    unsigned char *keys, *big_keys;
+    subtrie *child, *big_child;
+    int i;
+
+    big->freq = n->freq;
+    big->num_children = n->num_children;
+    if (n->kind == LEAF) {
+        return big;
+    } else if (n->kind == NODE48) {
+        for (i = 0; i < 256; i++) {
+            if (n48->index[i] != 0) {
+                ((struct trie_node256 *)big)->child[i]
+                    = n48->child[n48->index[i] - 1];
+            }
+        }
+        *trie_link(n) = T->spare[NODE48];
+        T->spare[NODE48] = n;
+        return big;
+    }
+    trie_slots(n, &keys, &child);
+    if (big->kind == NODE48) {
+        for (i = 0; i < n->num_children; i++) {
+            ((struct trie_node48 *)big)->index[keys[i]] = i + 1;
+            ((struct trie_node48 *)big)->child[i] = child[i];
+        }
+    } else {
+        trie_slots(big, &big_keys, &big_child);
+        memcpy(big_keys, keys, n->num_children);
+        memcpy(big_child, child, n->num_children * sizeof child[0]);
+    }
+    *trie_link(n) = T->spare[n->kind];
+    T->spare[n->kind] = n;
+    return big;
+}
+
+
+/**
+ * Adds a child to a node, growing the node first if it is full.
+ *
+ * @param T The trie the node belongs to.
+ * @param ref Where the node is kept, which is updated if it grows.
+ * @param c The byte to know the child by.
+ * @param node The child.
+ */
+static void trie_add_child(trie T, subtrie *ref, unsigned char c,
+                           subtrie node) {
+    subtrie n = *ref;
+    unsigned char *keys;
+    subtrie *child;
+    int i;
+
+    if (n->num_children == trie_capacity[n->kind]) {
+        n = *ref = trie_grow(T, n);
+    }
+    if (n->kind == NODE256) {
+        ((struct trie_node256 *)n)->child[c] = node;
+    } else if (n->kind == NODE48) {
+        ((struct trie_node48 *)n)->child[n->num_children] = node;
+        ((struct trie_node48 *)n)->index[c] = n->num_children + 1;
+    } else {
+        trie_slots(n, &keys, &child);
+        for (i = n->num_children; i > 0 && keys[i - 1] > c; i--) {
+            keys[i] = keys[i - 1];
+            child[i] = child[i - 1];
+        }
+        keys[i] = c;
+        child[i] = node;
+    }
+    n->num_children++;
+}
+
+
+/**
+ * Inserts a string into the trie, counting it a number of times. The
+ * search follows the string down the trie as far as it matches. If it
+ * stops part way through a prefix, that node is split at that point, and
+ * whatever is left of the string becomes a new leaf.
+ *
+ * @param T The trie we are inserting a word into.
+ * @param key The string we wish to place in the trie, which need not be
+ * '\0' terminated.
+ * @param len The length of the string.
+ * @param count The number of times to count the string.
+ *
+ * @return T the newly updated trie.
+ */
+trie trie_insert_count(trie T, const char *key, int len, int count) {
+    subtrie *ref = &T->root;
+    subtrie *next;
+    subtrie n, split;
+    char *prefix;
+    unsigned char c;
+    int depth = 0, p;
+
+    while ((n = *ref) != NULL) {
+        prefix = TRIE_PREFIX(n);
+        for (p = 0; p < n->prefix_len && depth + p < len
+                 && prefix[p] == key[depth + p]; p++) {
+        }
+        if (p < n->prefix_len) {
+            split = trie_node_new(T, NODE4, prefix, p);
+            c = (unsigned char)prefix[p];
+            n->prefix_len -= p + 1;
+            memmove(prefix, prefix + p + 1, n->prefix_len);
+            trie_add_child(T, &split, c, n);
+            *ref = n = split;
+        }
+        depth += p;
+        if (depth == len) {
+            n->freq += count;
+            return T;
+        }
+        if ((next = trie_find_child(n, (unsigned char)key[depth])) == NULL) {
+            split = trie_node_new(T, LEAF, key + depth + 1, len - depth - 1);
+            split->freq = count;
+            trie_add_child(T, ref, (unsigned char)key[depth], split);
+            return T;
+        }
+        ref = next;
+        depth++;
+    }
+    *ref = trie_node_new(T, LEAF, key + depth, len - depth);
+    (*ref)->freq = count;
+    return T;
+}
+
+
+/**
+ * Inserts a string into the trie.
+ *
+ * @param T The trie we are inserting a word into.
+ * @param key The string we wish to place in the trie, which need not be
+ * '\0' terminated.
+ * @param len The length of the string.
+ *
+ * @return T the newly updated trie.
+ */
+trie trie_insert_n(trie T, const char *key, int len) {
+    return trie_insert_count(T, key, len, 1);
+}
+
+
+/**
+ * Inserts a '\0' terminated string into the trie.
+ *
+ * @param T The trie we are inserting a word into.
+ * @param key The string we wish to place in the trie.
+ *
+ * @return T the newly updated trie.
+ */
+trie trie_insert(trie T, char *key) {
+    return trie_insert_n(T, key, strlen(key));
+}
+
+
+/**
+ * Searches the trie for a given string, checking the prefix of each node on
+ * the way down and then following the child for the next byte.
+ *
+ * @param T The trie to search.
+ * @param key The string to search for, which need not be '\0' terminated.
+ * @param len The length of the string.
+ *
+ * @return The frequency of the string, or 0 if it was not found.
+ */
+int trie_search_n(trie T, const char *key, int len) {
+    subtrie n = T->root;
+    subtrie *next;
+    int depth = 0;
+
+    while (n != NULL) {
+        if (n->prefix_len > len - depth
+            || memcmp(TRIE_PREFIX(n), key + depth, n->prefix_len) != 0) {
+            return 0;
+        }
+        depth += n->prefix_len;
+        if (depth == len) {
+            return n->freq;
+        }
+        if ((next = trie_find_child(n, (unsigned char)key[depth])) == NULL) {
+            return 0;
+        }
+        n = *next;
+        depth++;
+    }
+    return 0;
+}
+
+
+/**
+ * Searches the trie for a given '\0' terminated string.
+ *
+ * @param T The trie to search.
+ * @param key The string to search for.
+ *
+ * @return The frequency of the string, or 0 if it was not found.
+ */
+int trie_search(trie T, char *key) {
+    return trie_search_n(T, key, strlen(key));
+}
+
+
+/**
+ * Visits each node of the trie below a given depth, building up the word
+ * each node stands for.
+ *
+ * @param T The node.
+ * @param buf The word so far, which is grown as needed.
+ * @param size The size of buf.
+ * @param depth The length of the word so far.
+ * @param f The function to be executed on each word.
+ */
+static void trie_walk(subtrie T, char **buf, int *size, int depth,
+                      void f(int freq, char *key)) {
+    struct trie_node48 *n48 = (struct trie_node48 *)T;
+    unsigned char *keys;
+    subtrie *child;
+    int i;
+
+    if (depth + T->prefix_len + 2 > *size) {
+        *size = 2 * (depth + T->prefix_len + 2);
+        *buf = erealloc(*buf, *size);
+    }
+    memcpy(*buf + depth, TRIE_PREFIX(T), T->prefix_len);
+    depth += T->prefix_len;
+    if (T->freq > 0) {
+        (*buf)[depth] = '\0';
+        f(T->freq, *buf);
+    }
+    if (T->kind == NODE256) {
+        for (i = 0; i < 256; i++) {
+            if (((struct trie_node256 *)T)->child[i] != NULL) {
+                (*buf)[depth] = (char)i;
+                trie_walk(((struct trie_node256 *)T)->child[i], buf, size,
+                          depth + 1, f);
+            }
+        }
+    } else if (T->kind == NODE48) {
+        for (i = 0; i < 256; i++) {
+            if (n48->index[i] != 0) {
+                (*buf)[depth] = (char)i;
+                trie_walk(n48->child[n48->index[i] - 1], buf, size,
+                          depth + 1, f);
+            }
+        }
+    } else if (T->kind != LEAF) {
+        trie_slots(T, &keys, &child);
+        for (i = 0; i < T->num_children; i++) {
+            (*buf)[depth] = (char)keys[i];
+            trie_walk(child[i], buf, size, depth + 1, f);
+        }
+    }
+}
+
+
+/**
+ * Executes a function on each word of the trie in prefix order, which for
+ * a trie is the order the words sort in.
+ *
+ * @param T The trie on which to execute the function.
+ * @param f(char *key) The function to be executed.
+ */
+void trie_preorder(trie T, void f(int freq, char *key)) {
+    char *buf = NULL;
+    int size = 0;
+
+    if (T->root != NULL) {
+        trie_walk(T->root, &buf, &size, 0, f);
+    }
+    free(buf);
+}
+
+
+/**
+ * Frees all memory assosiated with the trie, one free per arena chunk,
+ * leaving any other trie as it was.
+ *
+ * @param T the trie we wish to deallocate memory for.
+ *
+ * @return a pointer to our now empty trie.
+ */
+trie trie_free(trie T) {
+    arena_free(T->store);
+    free(T);
+    T = NULL;
+    return T;
+}
@@ -0,0 +1,23 @@
+/**
+ * Header file for radix trie implementation.
+ *
+ */
+#ifndef TRIE_H_
+#define TRIE_H_
+
+#include <stdlib.h>
+#include <stdio.h>
+
+typedef struct trierec *trie;
+
+extern trie     trie_new(void);
+extern trie     trie_insert(trie T, char *key);
+extern trie     trie_insert_n(trie T, const char *key, int len);
+extern trie     trie_insert_count(trie T, const char *key, int len,
+                                  int count);
+extern int      trie_search(trie T, char *key);
+extern int      trie_search_n(trie T, const char *key, int len);
+extern void     trie_preorder(trie T, void f(int frequency, char *key));
+extern trie     trie_free(trie T);
+
+#endif
@@ -0,0 +1,225 @@
+/**
+ * A buffered writer for bulk output, such as dumping every word of the
+ * dictionary or every unknown word of a document. Output is gathered in a
+ * large buffer and written straight to the file descriptor under a stream,
+ * so nothing is formatted or locked by stdio once per line. Numbers are
+ * formatted by hand, and a block too big for the buffer is written along
+ * with what is buffered in one writev, without being copied. A writer can
+ * also be made over a socket, where a failed write is reported back rather
+ * than ending the program, since the other end may simply have gone.
+ *
+ */
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include "writer.h"
+#include "mylib.h"
+
+
+/**
+ * The size of the buffer output is gathered in.
+ */
+#define WRITER_BUFSIZE (1 << 20)
+
+
+/**
+ * writerrec struct is the blueprint for creating an instance of a writer.
+ * It writes to the file descriptor fd, with len bytes waiting in buf.
+ * Writers over a stream exit when a write fails, while others set failed
+ * and drop anything written after.
+ */
+struct writerrec {
+    int fd;
+    int fatal;
+    int failed;
+    size_t len;
+    char buf[WRITER_BUFSIZE];
+};
+
+
+/**
+ * Creates a writer over a stream. Anything the stream has buffered is
+ * flushed first, and nothing else should be written to the stream until
+ * the writer is freed, or the output will be out of order.
+ *
+ * @param stream The stream to write to.
+ *
+ * @return w The new writer.
+ */
+writer writer_new(FILE *stream) {
+    writer w;
+
+    fflush(stream);
+    w = writer_new_fd(fileno(stream));
+    w->fatal = 1;
+    return w;
+}
+
+
+/**
+ * Creates a writer over a file descriptor, such as a socket. A write which
+ * fails does not end the program, but is seen by writer_flush.
+ *
+ * @param fd The file descriptor to write to.
+ *
+ * @return w The new writer.
+ */
+writer writer_new_fd(int fd) {
+    writer w = emalloc(sizeof * w);
+    w->fd = fd;
+    w->fatal = 0;
+    w->failed = 0;
+    w->len = 0;
+    return w;
+}
+
+
+/**
+ * Writes out everything buffered followed by a block of bytes, with a
+ * single writev when the system takes it all at once.
+ *
+ * @param w The writer.
+ * @param s The block, or NULL to only write what is buffered.
+ * @param len The length of the block.
+ */
+static void writer_out(writer w, const char *s, size_t len) {
+    struct iovec iov[2];
+    int i = 0, n = 0;
+    ssize_t done;
+
+    if (w->failed) {
+        w->len = 0;
+        return;
+    }
+    if (w->len > 0) {
+        iov[n].iov_base = w->buf;
+        iov[n++].iov_len = w->len;
+    }
+    if (len > 0) {
+        iov[n].iov_base = (char *)s;
+        iov[n++].iov_len = len;
+    }
+    while (i < n) {
+        done = writev(w->fd, iov + i, n - i);
+        if (done < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (w->fatal) {
+                fprintf(stderr, "Can't write output\n");
+                exit(EXIT_FAILURE);
+            }
+            w->failed = 1;
+            break;
+        }
+        for (; i < n && (size_t)done >= iov[i].iov_len; i++) {
+            done -= iov[i].iov_len;
+        }
+        if (i < n) {
+            iov[i].iov_base = (char *)iov[i].iov_base + done;
+            iov[i].iov_len -= done;
+        }
+    }
+    w->len = 0;
+}
+
+
+/**
+ * Writes a block of bytes. A block which does not fit in the buffer is
+ * written out with it rather than copied in.
+ *
+ * @param w The writer.
+ * @param s The block.
+ * @param len The length of the block.
+ */
+void writer_bytes(writer w, const char *s, size_t len) {
+    if (w->len + len <= WRITER_BUFSIZE) {
+        memcpy(w->buf + w->len, s, len);
+        w->len += len;
+    } else {
+        writer_out(w, s, len);
+    }
+}
+
+
+/**
+ * Writes a '\0' terminated string.
+ *
+ * @param w The writer.
+ * @param s The string.
+ */
+void writer_string(writer w, const char *s) {
+    writer_bytes(w, s, strlen(s));
+}
+
+
+/**
+ * Writes a single character.
+ *
+ * @param w The writer.
+ * @param c The character.
+ */
+void writer_char(writer w, char c) {
+    if (w->len == WRITER_BUFSIZE) {
+        writer_out(w, NULL, 0);
+    }
+    w->buf[w->len++] = c;
+}
+
+
+/**
+ * Writes a number in decimal, padded with spaces on the right to at least
+ * a given width, as printf does for "%-*d".
+ *
+ * @param w The writer.
+ * @param n The number.
+ * @param width The least number of characters to write.
+ */
+void writer_int(writer w, int n, int width) {
+    char digits[16];
+    unsigned int u = n < 0 ? 0U - (unsigned int)n : (unsigned int)n;
+    int i = sizeof digits, len;
+
+    do {
+        digits[--i] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u > 0);
+    if (n < 0) {
+        digits[--i] = '-';
+    }
+    len = sizeof digits - i;
+    writer_bytes(w, digits + i, len);
+    while (len++ < width) {
+        writer_char(w, ' ');
+    }
+}
+
+
+/**
+ * Writes out everything buffered.
+ *
+ * @param w The writer.
+ *
+ * @return 1 if everything written so far has gone out, or 0 if a write
+ * failed.
+ */
+int writer_flush(writer w) {
+    if (w->len > 0) {
+        writer_out(w, NULL, 0);
+    }
+    return !w->failed;
+}
+
+
+/**
+ * Writes out everything buffered and frees the writer.
+ *
+ * @param w The writer.
+ */
+void writer_free(writer w) {
+    writer_flush(w);
+    free(w);
+}
@@ -0,0 +1,21 @@
+/**
+ * Header file for buffered output writer implementation.
+ *
+ */
+#ifndef WRITER_H_
+#define WRITER_H_
+
+#include <stdio.h>
+
+typedef struct writerrec *writer;
+
+extern writer writer_new(FILE *stream);
+extern writer writer_new_fd(int fd);
+extern void   writer_bytes(writer w, const char *s, size_t len);
+extern void   writer_string(writer w, const char *s);
+extern void   writer_char(writer w, char c);
+extern void   writer_int(writer w, int n, int width);
+extern int    writer_flush(writer w);
+extern void   writer_free(writer w);
+
+#endif